@@ -0,0 +1,515 @@
+//===-- CFGEmitters.cpp - CFG output formats ------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Emitters for the CFGs reported by a CFGWalker.
+///
+//===----------------------------------------------------------------------===//
+
+#include "CFGEmitters.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/Path.h"
+
+#include <numeric>
+
+using namespace llvm;
+using namespace cfgtojson;
+
+//===----------------------------------------------------------------------===//
+// Helpers
+//===----------------------------------------------------------------------===//
+
+namespace {
+// Hands the text written by a Json::CompactWriter to an LLVM stream
+class RawOStreamSink : public Json::CompactWriter::Sink {
+public:
+  explicit RawOStreamSink(raw_ostream &OS) : OS(OS) {}
+
+  void write(const char *Data, size_t Length) override {
+    OS.write(Data, Length);
+  }
+
+private:
+  raw_ostream &OS;
+};
+} // end anonymous namespace
+
+// Write a JSON document, either compact or pretty-printed
+static void writeJSON(const Json::Value &V, bool Compact, raw_ostream &OS) {
+  if (!Compact) {
+    OS << V.toStyledString();
+    return;
+  }
+
+  RawOStreamSink Sink(OS);
+  Json::CompactWriter Writer(Sink);
+  Writer.write(V);
+}
+
+// Order in which to emit functions, given a key for each function. Functions
+// with equal keys remain in their original order
+static SmallVector<unsigned, 0> getFunctionOrder(ArrayRef<uint64_t> Keys,
+                                                 bool Descending) {
+  SmallVector<unsigned, 0> Order(Keys.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::stable_sort(Order.begin(), Order.end(), [&](unsigned LHS, unsigned RHS) {
+    return Descending ? Keys[LHS] > Keys[RHS] : Keys[LHS] < Keys[RHS];
+  });
+  return Order;
+}
+
+// Reorder an array of JSON functions, and save each function's key
+static void orderJSONFunctions(Json::Value &JFuncs, ArrayRef<uint64_t> Keys,
+                               bool Descending, const char *KeyName) {
+  Json::Value JOrderedFuncs(Json::arrayValue);
+  for (auto Idx : getFunctionOrder(Keys, Descending)) {
+    JFuncs[Idx][KeyName] = static_cast<Json::UInt64>(Keys[Idx]);
+    JOrderedFuncs.append(std::move(JFuncs[Idx]));
+  }
+  JFuncs.swap(JOrderedFuncs);
+}
+
+// Move a JSON value out, leaving an empty value of the same type behind (so
+// that a cleared array is still written as `[]`, not `null`)
+static Json::Value takeJSON(Json::Value &V) {
+  Json::Value Taken(V.type());
+  Taken.swap(V);
+  return Taken;
+}
+
+static std::string getSourcePath(const DIFile *File) {
+  const auto Filename = File->getFilename();
+  const auto Dir = File->getDirectory();
+  if (Dir.empty() || sys::path::is_absolute(Filename)) {
+    return Filename.str();
+  }
+
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Filename);
+  return std::string(Path.str());
+}
+
+// The line index maps each source line to the blocks containing it, sorted by
+// line (so that a line can be found by binary search). Each entry is a
+// [line, function, block] triple
+static Json::Value getLineIndex(LineIndex &Index) {
+  Json::Value JIndex;
+
+  for (auto &Entry : Index) {
+    auto &Lines = Entry.getValue();
+    std::stable_sort(Lines.begin(), Lines.end(),
+                     [](const LineIndexEntry &LHS, const LineIndexEntry &RHS) {
+                       return LHS.Line < RHS.Line;
+                     });
+
+    auto &JLines = JIndex[Entry.getKey().str()];
+    for (const auto &Line : Lines) {
+      Json::Value JLine;
+      JLine.append(Line.Line);
+      JLine.append(getNameOrAsOperand(Line.F));
+      JLine.append(Line.Block);
+      JLines.append(std::move(JLine));
+    }
+  }
+
+  return JIndex;
+}
+
+// Summarize the shortest intra-procedural distances (in number of edges) from
+// the function's entry and call sites to each of its returns. Inter-procedural
+// distances can then be computed from these summaries, without traversing
+// every basic block again. Returns that are unreachable from a block are
+// omitted
+static Json::Value
+getDistanceSummary(const Function &F, ArrayRef<LabelledBlock> Returns,
+                   ArrayRef<LabelledBlock> CallSites,
+                   const SmallPtrSetImpl<const BasicBlock *> &ReachableBBs) {
+  Json::Value JEntry(Json::objectValue), JCallSites(Json::objectValue);
+  const auto *EntryBB = &F.getEntryBlock();
+
+  DenseMap<const BasicBlock *, unsigned> Dists;
+  SmallVector<const BasicBlock *, 32> Queue;
+
+  for (const auto &[RetBB, RetLabel] : Returns) {
+    // Breadth-first search backwards from the return
+    Dists.clear();
+    Queue.clear();
+    Dists[RetBB] = 0;
+    Queue.push_back(RetBB);
+
+    for (unsigned I = 0; I < Queue.size(); ++I) {
+      const auto *BB = Queue[I];
+      const auto Dist = Dists[BB];
+
+      for (const auto *Pred : predecessors(BB)) {
+        if (ReachableBBs.count(Pred) &&
+            Dists.try_emplace(Pred, Dist + 1).second) {
+          Queue.push_back(Pred);
+        }
+      }
+    }
+
+    if (auto It = Dists.find(EntryBB); It != Dists.end()) {
+      JEntry[RetLabel] = It->second;
+    }
+    for (const auto &[CallBB, CallLabel] : CallSites) {
+      if (auto It = Dists.find(CallBB); It != Dists.end()) {
+        JCallSites[CallLabel][RetLabel] = It->second;
+      }
+    }
+  }
+
+  Json::Value JDists;
+  JDists["entry"] = JEntry;
+  JDists["calls"] = JCallSites;
+  return JDists;
+}
+
+// Canonical structural hash of a JSON value. Object members are combined
+// independently of their (insertion) order, so equal values always hash equally
+static hash_code hashJSON(const Json::Value &V) {
+  hash_code H = hash_value(static_cast<int>(V.type()));
+
+  switch (V.type()) {
+  case Json::intValue:
+    return hash_combine(H, V.asLargestInt());
+  case Json::uintValue:
+    return hash_combine(H, V.asLargestUInt());
+  case Json::realValue:
+    return hash_combine(H, V.asString());
+  case Json::booleanValue:
+    return hash_combine(H, V.asBool());
+  case Json::stringValue: {
+    const char *Begin, *End;
+    V.getString(&Begin, &End);
+    return hash_combine(H, StringRef(Begin, End - Begin));
+  }
+  case Json::arrayValue:
+    for (const auto &Elem : V) {
+      H = hash_combine(H, hashJSON(Elem));
+    }
+    return H;
+  case Json::objectValue: {
+    size_t Members = 0;
+    for (auto It = V.begin(), End = V.end(); It != End; ++It) {
+      const char *KeyEnd;
+      const char *Key = It.memberName(&KeyEnd);
+      Members += hash_combine(StringRef(Key, KeyEnd - Key), hashJSON(*It));
+    }
+    return hash_combine(H, Members);
+  }
+  default:
+    return H;
+  }
+}
+
+// Return the index of the given shape in `JShapes`, adding it if an identical
+// shape has not been seen before
+static unsigned getShapeIndex(Json::Value &&JShape, Json::Value &JShapes,
+                              ShapeMap &Shapes) {
+  auto &Candidates = Shapes[hashJSON(JShape)];
+  for (auto Idx : Candidates) {
+    if (JShapes[Idx] == JShape) {
+      return Idx;
+    }
+  }
+
+  unsigned Idx = JShapes.size();
+  JShapes.append(std::move(JShape));
+  Candidates.push_back(Idx);
+  return Idx;
+}
+
+//===----------------------------------------------------------------------===//
+// JSONEmitter
+//===----------------------------------------------------------------------===//
+
+// Save every source line in the basic block (not just those that make up its
+// source range). For inlined code, the line is attributed to the file the code
+// was inlined from, not the file it was inlined into
+void JSONEmitter::addLines(const BasicBlock *BB) {
+  BBLines.clear();
+  for (const auto &I : *BB) {
+    if (isa<DbgInfoIntrinsic>(&I)) {
+      continue;
+    }
+
+    const auto *Loc = I.getDebugLoc().get();
+    if (Loc && Loc->getFile() && Loc->getLine()) {
+      BBLines.insert({Loc->getFile(), Loc->getLine()});
+    }
+  }
+
+  for (const auto &[File, Line] : BBLines) {
+    Lines[getSourcePath(File)].push_back({Line, BB->getParent(), BBLabel});
+  }
+}
+
+void JSONEmitter::endFunction(const Function &F) {
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+
+  if (Opts.ShareShapes) {
+    // The shape is everything except the function name and the source lines.
+    // The lines are stored per function, in the same order as the shape's
+    // blocks
+    Json::Value JShape, JLines;
+    JShape["entry"] = getBBLabel(&F.getEntryBlock());
+    for (const auto &Label : JBlocks.getMemberNames()) {
+      const auto &JBlock = JBlocks[Label];
+
+      Json::Value JLine;
+      JLine.append(JBlock["start_line"]);
+      JLine.append(JBlock["end_line"]);
+
+      JShape["blocks"].append(Label);
+      JLines.append(std::move(JLine));
+    }
+    JShape["edges"] = takeJSON(JEdges);
+    JShape["calls"] = takeJSON(JCalls);
+    JShape["returns"] = takeJSON(JReturns);
+    JShape["unresolved_calls"] = takeJSON(JUnresolvedCalls);
+    if (Opts.Distances) {
+      JShape["distances"] =
+          getDistanceSummary(F, RetBBs, CallBBs, ReachableBBs);
+    }
+
+    JFunc["shape"] = getShapeIndex(std::move(JShape), JShapes, Shapes);
+    JFunc["lines"] = std::move(JLines);
+  } else {
+    JFunc["entry"] = getBBLabel(&F.getEntryBlock());
+    JFunc["blocks"] = takeJSON(JBlocks);
+    JFunc["edges"] = takeJSON(JEdges);
+    JFunc["calls"] = takeJSON(JCalls);
+    JFunc["returns"] = takeJSON(JReturns);
+    JFunc["unresolved_calls"] = takeJSON(JUnresolvedCalls);
+    if (Opts.Distances) {
+      JFunc["distances"] = getDistanceSummary(F, RetBBs, CallBBs, ReachableBBs);
+    }
+  }
+
+  JFuncs.append(std::move(JFunc));
+}
+
+// Call graph node for a function: its direct callees (with call counts) and
+// its number of indirect calls. Callees that are only declared in this module
+// are saved as external
+void JSONEmitter::callGraphNode(const Function &F, const CallCounts &Callees,
+                                unsigned NumIndirectCalls) {
+  Json::Value JCallees(Json::arrayValue);
+  for (const auto &[Callee, Count] : Callees) {
+    const auto *Target = Callee.first;
+    const auto Opcode = Callee.second;
+
+    Json::Value JCallee;
+    JCallee[keys::Dst] = getCalleeName(Target);
+    JCallee[keys::Type] = Instruction::getOpcodeName(Opcode);
+    JCallee[keys::Count] = Count;
+    JCallees.append(JCallee);
+
+    const auto *CalleeF = dyn_cast<Function>(Target);
+    if (CalleeF && CalleeF->isDeclaration()) {
+      External.insert(JCallee[keys::Dst].asString());
+    }
+  }
+
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+  JFunc["callees"] = std::move(JCallees);
+  JFunc["indirect_calls"] = NumIndirectCalls;
+  JFuncs.append(std::move(JFunc));
+}
+
+void JSONEmitter::functionRef(const Function &F, StringRef ODRKey) {
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+  JFunc["odr_ref"] = ODRKey.str();
+  JFuncs.append(std::move(JFunc));
+}
+
+void JSONEmitter::orderFunctions(ArrayRef<uint64_t> Keys, bool Descending,
+                                 const char *KeyName) {
+  orderJSONFunctions(JFuncs, Keys, Descending, KeyName);
+}
+
+void JSONEmitter::finish(const Module &M, raw_ostream &OS) {
+  Json::Value JMod;
+  JMod["module"] = M.getName().str();
+  JMod["functions"] = std::move(JFuncs);
+  if (Opts.CallGraph) {
+    Json::Value JExternal(Json::arrayValue);
+    for (const auto &Name : External) {
+      JExternal.append(Name);
+    }
+    JMod["external"] = JExternal;
+  } else {
+    if (Opts.ShareShapes) {
+      JMod["shapes"] = std::move(JShapes);
+    }
+    if (Opts.LineIndex) {
+      JMod["line_index"] = getLineIndex(Lines);
+    }
+  }
+
+  writeJSON(JMod, Opts.Compact, OS);
+}
+
+//===----------------------------------------------------------------------===//
+// BinaryEmitter
+//===----------------------------------------------------------------------===//
+
+void BinaryEmitter::write(Buffer &Buf, uint64_t Val) {
+  uint8_t Bytes[16];
+  const auto Size = encodeULEB128(Val, Bytes);
+  Buf.append(Bytes, Bytes + Size);
+}
+
+void BinaryEmitter::beginChunk(FunctionKind Kind, const Function &F) {
+  Chunks.emplace_back(Body.size(), 0);
+  write(Body, Kind);
+  write(Body, getStringId(getNameOrAsOperand(&F)));
+}
+
+void BinaryEmitter::endFunction(const Function &F) {
+  beginChunk(FunctionCFG, F);
+  write(Body, getBlockId(&F.getEntryBlock()));
+
+  for (const auto &[Count, Section] :
+       {std::make_pair(NumBlocks, &Blocks), std::make_pair(NumEdges, &Edges),
+        std::make_pair(NumCalls, &Calls),
+        std::make_pair(NumUnresolvedCalls, &UnresolvedCalls),
+        std::make_pair(NumReturns, &Returns)}) {
+    write(Body, Count);
+    Body.append(Section->begin(), Section->end());
+  }
+
+  Chunks.back().second = Body.size() - Chunks.back().first;
+}
+
+void BinaryEmitter::callGraphNode(const Function &F, const CallCounts &Callees,
+                                  unsigned NumIndirectCalls) {
+  beginChunk(FunctionCallGraph, F);
+
+  write(Body, Callees.size());
+  for (const auto &[Callee, Count] : Callees) {
+    write(Body, getCalleeId(Callee.first));
+    write(Body, getStringId(Instruction::getOpcodeName(Callee.second)));
+    write(Body, Count);
+
+    const auto *CalleeF = dyn_cast<Function>(Callee.first);
+    write(Body, CalleeF && CalleeF->isDeclaration());
+  }
+  write(Body, NumIndirectCalls);
+
+  Chunks.back().second = Body.size() - Chunks.back().first;
+}
+
+void BinaryEmitter::functionRef(const Function &F, StringRef ODRKey) {
+  beginChunk(FunctionODRRef, F);
+  write(Body, getStringId(ODRKey));
+  Chunks.back().second = Body.size() - Chunks.back().first;
+}
+
+void BinaryEmitter::orderFunctions(ArrayRef<uint64_t> Keys, bool Descending,
+                                   const char *KeyName) {
+  decltype(Chunks) OrderedChunks;
+  OrderedChunks.reserve(Chunks.size());
+  OrderKeys.clear();
+  OrderKeys.reserve(Keys.size());
+  for (auto Idx : getFunctionOrder(Keys, Descending)) {
+    OrderedChunks.push_back(Chunks[Idx]);
+    OrderKeys.push_back(Keys[Idx]);
+  }
+  Chunks.swap(OrderedChunks);
+  OrderKeyName = KeyName;
+}
+
+void BinaryEmitter::finish(const Module &M, raw_ostream &OS) {
+  const auto ModId = getStringId(M.getName());
+  const auto OrderKeyId = OrderKeyName ? getStringId(OrderKeyName) + 1 : 0;
+
+  Buffer Out;
+  Out.append({'L', 'C', 'F', 'G'});
+  char VersionBytes[4];
+  support::endian::write32le(VersionBytes, Version);
+  Out.append(VersionBytes, VersionBytes + sizeof(VersionBytes));
+
+  write(Out, Strings.size());
+  for (const auto &Str : Strings) {
+    write(Out, Str.size());
+    Out.append(Str.begin(), Str.end());
+  }
+
+  write(Out, ModId);
+  write(Out, OrderKeyId);
+  write(Out, Chunks.size());
+  for (size_t I = 0; I < Chunks.size(); ++I) {
+    const auto &[Offset, Size] = Chunks[I];
+    Out.append(Body.begin() + Offset, Body.begin() + Offset + Size);
+    if (OrderKeyName) {
+      write(Out, OrderKeys[I]);
+    }
+  }
+
+  OS.write(Out.data(), Out.size());
+}
+
+//===----------------------------------------------------------------------===//
+// SummaryEmitter
+//===----------------------------------------------------------------------===//
+
+void SummaryEmitter::endFunction(const Function &F) {
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+  JFunc["blocks"] = NumBlocks;
+  JFunc["edges"] = NumEdges;
+  JFunc["calls"] = NumCalls;
+  JFunc["unresolved_calls"] = NumUnresolvedCalls;
+  JFunc["returns"] = NumReturns;
+  JFuncs.append(std::move(JFunc));
+}
+
+void SummaryEmitter::callGraphNode(const Function &F,
+                                   const CallCounts &Callees,
+                                   unsigned NumIndirectCalls) {
+  unsigned NumCalls = 0;
+  for (const auto &Callee : Callees) {
+    NumCalls += Callee.second;
+  }
+
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+  JFunc["callees"] = static_cast<Json::UInt>(Callees.size());
+  JFunc["calls"] = NumCalls;
+  JFunc["indirect_calls"] = NumIndirectCalls;
+  JFuncs.append(std::move(JFunc));
+}
+
+void SummaryEmitter::functionRef(const Function &F, StringRef ODRKey) {
+  Json::Value JFunc;
+  JFunc["name"] = getNameOrAsOperand(&F);
+  JFunc["odr_ref"] = ODRKey.str();
+  JFuncs.append(std::move(JFunc));
+}
+
+void SummaryEmitter::orderFunctions(ArrayRef<uint64_t> Keys, bool Descending,
+                                    const char *KeyName) {
+  orderJSONFunctions(JFuncs, Keys, Descending, KeyName);
+}
+
+void SummaryEmitter::finish(const Module &M, raw_ostream &OS) {
+  Json::Value JMod;
+  JMod["module"] = M.getName().str();
+  JMod["functions"] = std::move(JFuncs);
+
+  writeJSON(JMod, Compact, OS);
+}
@@ -0,0 +1,399 @@
+//===-- CFGEmitters.h - CFG output formats ----------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Emitters for the CFGs reported by a CFGWalker. Each emitter accumulates the
+/// functions of a single module. In addition to the walker events (see
+/// CFGWalker.h), an emitter provides:
+///
+///   static constexpr const char *Extension;
+///   void functionRef(const Function &F, StringRef ODRKey);
+///   void orderFunctions(ArrayRef<uint64_t> Keys, bool Descending,
+///                       const char *KeyName);
+///   void finish(const Module &M, raw_ostream &OS);
+///
+/// Event handlers are defined inline, so that they can be inlined into the
+/// walk.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_TO_JSON_CFG_EMITTERS_H
+#define CFG_TO_JSON_CFG_EMITTERS_H
+
+#include "CFGWalker.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Module.h"
+
+#include "json/json.h"
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace cfgtojson {
+
+// A basic block containing an instruction at a given source line
+struct LineIndexEntry {
+  unsigned Line;
+  const llvm::Function *F;
+  std::string Block;
+};
+
+// Maps a source file to the basic blocks containing its lines
+using LineIndex = llvm::StringMap<std::vector<LineIndexEntry>>;
+
+// A basic block and its label
+using LabelledBlock = std::pair<const llvm::BasicBlock *, std::string>;
+
+// Maps a structural hash to the indices of the shapes that have it
+using ShapeMap = std::unordered_map<size_t, llvm::SmallVector<unsigned, 1>>;
+
+// Keys of the objects emitted for every block, edge, call and return. They
+// are interned, so that they are stored once rather than once per object
+namespace keys {
+inline const Json::InternedKey StartLine("start_line");
+inline const Json::InternedKey EndLine("end_line");
+inline const Json::InternedKey Src("src");
+inline const Json::InternedKey Dst("dst");
+inline const Json::InternedKey Type("type");
+inline const Json::InternedKey Count("count");
+inline const Json::InternedKey Block("block");
+} // namespace keys
+
+// The JSON format (`cfg.*.json`)
+class JSONEmitter {
+public:
+  static constexpr const char *Extension = "json";
+
+  struct Options {
+    // Functions are exported as call graph nodes
+    bool CallGraph = false;
+    // Emit structurally-identical function CFGs once
+    bool ShareShapes = false;
+    // Emit an index from source (file, line) to basic blocks
+    bool LineIndex = false;
+    // Emit per-function distance summaries
+    bool Distances = false;
+    // Write JSON without whitespace
+    bool Compact = false;
+  };
+
+  explicit JSONEmitter(const Options &Opts) : Opts(Opts) {}
+
+  void beginFunction(const llvm::Function &) {
+    JBlocks.clear();
+    JEdges.clear();
+    JCalls.clear();
+    JUnresolvedCalls.clear();
+    JReturns.clear();
+    RetBBs.clear();
+    CallBBs.clear();
+    ReachableBBs.clear();
+  }
+
+  void block(const llvm::BasicBlock *BB) {
+    BBLabel = getBBLabel(BB);
+    const auto &[SrcStart, SrcEnd] = getSourceRange(BB);
+
+    Json::Value JBlock;
+    JBlock[keys::StartLine] = SrcStart ? SrcStart.getLine() : Json::Value();
+    JBlock[keys::EndLine] = SrcEnd ? SrcEnd.getLine() : Json::Value();
+    JBlocks[BBLabel] = std::move(JBlock);
+
+    if (Opts.LineIndex) {
+      addLines(BB);
+    }
+    if (Opts.Distances) {
+      ReachableBBs.insert(BB);
+    }
+  }
+
+  void edge(const llvm::BasicBlock *Src, const llvm::BasicBlock *Dst) {
+    Json::Value JEdge;
+    JEdge[keys::Src] = BBLabel;
+    JEdge[keys::Dst] = getBBLabel(Dst);
+    JEdge[keys::Type] = Src->getTerminator()->getOpcodeName();
+    JEdges.append(std::move(JEdge));
+  }
+
+  void calls(const llvm::BasicBlock *BB, const CallCounts &Calls,
+             unsigned NumIndirectCalls) {
+    for (const auto &[Call, Count] : Calls) {
+      const auto *Target = Call.first;
+      const auto Opcode = Call.second;
+
+      Json::Value JCall;
+      JCall[keys::Src] = BBLabel;
+      JCall[keys::Dst] = getCalleeName(Target);
+      JCall[keys::Type] = llvm::Instruction::getOpcodeName(Opcode);
+      JCall[keys::Count] = Count;
+
+      JCalls.append(std::move(JCall));
+    }
+
+    if (NumIndirectCalls) {
+      JUnresolvedCalls[BBLabel] = NumIndirectCalls;
+    }
+
+    if (Opts.Distances) {
+      CallBBs.emplace_back(BB, BBLabel);
+    }
+  }
+
+  void ret(const llvm::BasicBlock *BB, const llvm::Instruction *Term) {
+    Json::Value JReturn;
+    JReturn[keys::Block] = BBLabel;
+    JReturn[keys::Type] = Term->getOpcodeName();
+
+    JReturns.append(std::move(JReturn));
+
+    if (Opts.Distances) {
+      RetBBs.emplace_back(BB, BBLabel);
+    }
+  }
+
+  void endFunction(const llvm::Function &F);
+  void callGraphNode(const llvm::Function &F, const CallCounts &Callees,
+                     unsigned NumIndirectCalls);
+  void functionRef(const llvm::Function &F, llvm::StringRef ODRKey);
+  void orderFunctions(llvm::ArrayRef<uint64_t> Keys, bool Descending,
+                      const char *KeyName);
+  void finish(const llvm::Module &M, llvm::raw_ostream &OS);
+
+private:
+  // Add every source line in the basic block to the line index
+  void addLines(const llvm::BasicBlock *BB);
+
+  const Options Opts;
+
+  // Label of the current basic block
+  std::string BBLabel;
+
+  Json::Value JFuncs, JBlocks, JEdges, JCalls, JUnresolvedCalls, JReturns;
+  Json::Value JShapes;
+  ShapeMap Shapes;
+
+  // Source lines in a single basic block
+  llvm::SmallSetVector<std::pair<const llvm::DIFile *, unsigned>, 8> BBLines;
+  LineIndex Lines;
+
+  // Return blocks, blocks containing calls, and reachable blocks (distance
+  // summaries only)
+  llvm::SmallVector<LabelledBlock, 4> RetBBs, CallBBs;
+  llvm::SmallPtrSet<const llvm::BasicBlock *, 32> ReachableBBs;
+
+  // Functions called but not defined in this module (call graph only)
+  std::set<std::string> External;
+};
+
+// A compact binary format (`cfg.*.bin`). All strings are stored once, in a
+// string table, and are referred to by their index in the table. Integers are
+// ULEB128-encoded, unless stated otherwise:
+//
+//   magic "LCFG" (4 bytes), version (32-bit little endian)
+//   num. strings, { length, bytes }*
+//   module name, order key, num. functions, function*
+//
+// The order key is the string id (plus one) of the name of the key that the
+// functions are ordered by (e.g., "scc" with -cfg-order=scc), or 0 if they are
+// in module order. Each function starts with its kind and name. The rest
+// depends on the kind:
+//
+//   0 (CFG):        entry, num. blocks, { label, start line, end line }*,
+//                   num. edges, { src, dst, type }*,
+//                   num. calls, { src, dst, type, count }*,
+//                   num. unresolved calls, { block, count }*,
+//                   num. returns, { block, type }*
+//   1 (call graph): num. callees, { dst, type, count, external }*,
+//                   num. indirect calls
+//   2 (ODR ref):    registry key
+//
+// followed by the function's order key value, if there is an order key.
+// Unknown source lines are stored as 0. A callee is external (1) if it is only
+// declared in the module, and 0 otherwise (since version 3).
+class BinaryEmitter {
+public:
+  static constexpr const char *Extension = "bin";
+  static constexpr uint32_t Version = 3;
+
+  enum FunctionKind { FunctionCFG, FunctionCallGraph, FunctionODRRef };
+
+  void beginFunction(const llvm::Function &) {
+    BlockIds.clear();
+    Blocks.clear();
+    Edges.clear();
+    Calls.clear();
+    UnresolvedCalls.clear();
+    Returns.clear();
+    NumBlocks = NumEdges = NumCalls = NumUnresolvedCalls = NumReturns = 0;
+  }
+
+  void block(const llvm::BasicBlock *BB) {
+    BBId = getBlockId(BB);
+    const auto &[SrcStart, SrcEnd] = getSourceRange(BB);
+
+    write(Blocks, BBId);
+    write(Blocks, SrcStart ? SrcStart.getLine() : 0);
+    write(Blocks, SrcEnd ? SrcEnd.getLine() : 0);
+    NumBlocks++;
+  }
+
+  void edge(const llvm::BasicBlock *Src, const llvm::BasicBlock *Dst) {
+    write(Edges, BBId);
+    write(Edges, getBlockId(Dst));
+    write(Edges, getStringId(Src->getTerminator()->getOpcodeName()));
+    NumEdges++;
+  }
+
+  void calls(const llvm::BasicBlock *, const CallCounts &BBCalls,
+             unsigned NumIndirectCalls) {
+    for (const auto &[Call, Count] : BBCalls) {
+      write(Calls, BBId);
+      write(Calls, getCalleeId(Call.first));
+      write(Calls, getStringId(llvm::Instruction::getOpcodeName(Call.second)));
+      write(Calls, Count);
+      NumCalls++;
+    }
+
+    if (NumIndirectCalls) {
+      write(UnresolvedCalls, BBId);
+      write(UnresolvedCalls, NumIndirectCalls);
+      NumUnresolvedCalls++;
+    }
+  }
+
+  void ret(const llvm::BasicBlock *, const llvm::Instruction *Term) {
+    write(Returns, BBId);
+    write(Returns, getStringId(Term->getOpcodeName()));
+    NumReturns++;
+  }
+
+  void endFunction(const llvm::Function &F);
+  void callGraphNode(const llvm::Function &F, const CallCounts &Callees,
+                     unsigned NumIndirectCalls);
+  void functionRef(const llvm::Function &F, llvm::StringRef ODRKey);
+  void orderFunctions(llvm::ArrayRef<uint64_t> Keys, bool Descending,
+                      const char *KeyName);
+  void finish(const llvm::Module &M, llvm::raw_ostream &OS);
+
+private:
+  using Buffer = llvm::SmallVector<char, 0>;
+
+  static void write(Buffer &Buf, uint64_t Val);
+
+  unsigned getStringId(llvm::StringRef Str) {
+    auto [It, Inserted] = StringIds.try_emplace(Str, Strings.size());
+    if (Inserted) {
+      Strings.push_back(It->getKey());
+    }
+    return It->getValue();
+  }
+
+  unsigned getBlockId(const llvm::BasicBlock *BB) {
+    auto [It, Inserted] = BlockIds.try_emplace(BB, 0);
+    if (Inserted) {
+      It->second = getStringId(getBBLabel(BB));
+    }
+    return It->second;
+  }
+
+  unsigned getCalleeId(const llvm::Value *Target) {
+    auto [It, Inserted] = CalleeIds.try_emplace(Target, 0);
+    if (Inserted) {
+      It->second = getStringId(getCalleeName(Target));
+    }
+    return It->second;
+  }
+
+  // Start a new function in `Body`
+  void beginChunk(FunctionKind Kind, const llvm::Function &F);
+
+  // String table
+  llvm::StringMap<unsigned> StringIds;
+  std::vector<llvm::StringRef> Strings;
+
+  // String ids of the current function's block labels, and of every callee
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> BlockIds;
+  llvm::DenseMap<const llvm::Value *, unsigned> CalleeIds;
+
+  // Label id of the current basic block
+  unsigned BBId = 0;
+
+  // Sections of the current function
+  Buffer Blocks, Edges, Calls, UnresolvedCalls, Returns;
+  unsigned NumBlocks = 0, NumEdges = 0, NumCalls = 0, NumUnresolvedCalls = 0,
+           NumReturns = 0;
+
+  // Encoded functions, and the (offset, size) of each function in `Body`
+  Buffer Body;
+  std::vector<std::pair<size_t, size_t>> Chunks;
+
+  // Name of the key that functions are ordered by (if any), and each (ordered)
+  // function's key
+  const char *OrderKeyName = nullptr;
+  std::vector<uint64_t> OrderKeys;
+};
+
+// Per-function counts only (`cfg.*.summary.json`). Basic blocks are not
+// labelled and source ranges are not computed
+class SummaryEmitter {
+public:
+  static constexpr const char *Extension = "summary.json";
+
+  // Write JSON without whitespace
+  explicit SummaryEmitter(bool Compact) : Compact(Compact) {}
+
+  void beginFunction(const llvm::Function &) {
+    NumBlocks = NumEdges = NumCalls = NumUnresolvedCalls = NumReturns = 0;
+  }
+
+  void block(const llvm::BasicBlock *) { NumBlocks++; }
+
+  void edge(const llvm::BasicBlock *, const llvm::BasicBlock *) {
+    NumEdges++;
+  }
+
+  void calls(const llvm::BasicBlock *, const CallCounts &Calls,
+             unsigned NumIndirectCalls) {
+    for (const auto &Call : Calls) {
+      NumCalls += Call.second;
+    }
+    NumUnresolvedCalls += NumIndirectCalls;
+  }
+
+  void ret(const llvm::BasicBlock *, const llvm::Instruction *) {
+    NumReturns++;
+  }
+
+  void endFunction(const llvm::Function &F);
+  void callGraphNode(const llvm::Function &F, const CallCounts &Callees,
+                     unsigned NumIndirectCalls);
+  void functionRef(const llvm::Function &F, llvm::StringRef ODRKey);
+  void orderFunctions(llvm::ArrayRef<uint64_t> Keys, bool Descending,
+                      const char *KeyName);
+  void finish(const llvm::Module &M, llvm::raw_ostream &OS);
+
+private:
+  const bool Compact;
+
+  unsigned NumBlocks = 0, NumEdges = 0, NumCalls = 0, NumUnresolvedCalls = 0,
+           NumReturns = 0;
+
+  Json::Value JFuncs;
+};
+
+} // namespace cfgtojson
+
+#endif // CFG_TO_JSON_CFG_EMITTERS_H
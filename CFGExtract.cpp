@@ -0,0 +1,265 @@
+//===-- CFGExtract.cpp - Export CFGs from existing bitcode ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Runs the CFG to JSON pass over existing bitcode (or textual IR) files, e.g.,
+/// whole-program bitcode from gllvm/wllvm or an LTO cache, without rerunning
+/// the compiler. Static archives of bitcode files, and object files with
+/// embedded bitcode (`-fembed-bitcode`), are also accepted. Modules are
+/// extracted in parallel, by worker threads that each parse modules into their
+/// own LLVMContext. Accepts the same `-cfg-*` options as the plugin.
+///
+/// Modules are loaded lazily: function bodies are only read when they are
+/// extracted, and released afterwards. Together with `-cfg-functions`, this
+/// keeps memory close to the size of the largest extracted function, rather
+/// than that of the whole module.
+///
+//===----------------------------------------------------------------------===//
+
+#include "CFGToJSON.h"
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Object/IRObjectFile.h"
+#include "llvm/Pass.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+using namespace cfgtojson;
+
+static cl::list<std::string>
+    InputFilenames(cl::Positional, cl::OneOrMore,
+                   cl::desc("<input .bc/.ll/.a/.o files>"));
+
+static cl::opt<unsigned>
+    NumThreads("j",
+               cl::desc("Number of worker threads (default: one per hardware "
+                        "thread)"),
+               cl::value_desc("N"), cl::init(0));
+
+namespace {
+
+// A module to extract: a bitcode (or textual IR) file, or the bitcode of an
+// archive member or in an object file's `.llvmbc` section. `Data` points into
+// the input file's mapping, so that modules are parsed without being copied.
+// `OutputName` names the module's outputs, if set (see nameOutputs)
+struct ModuleInput {
+  std::string Name;
+  StringRef Data;
+  std::string OutputName;
+};
+
+// The modules to extract, and the (memory-mapped) files and archives that they
+// point into. These must outlive the workers
+struct Inputs {
+  std::vector<ModuleInput> Modules;
+  std::vector<std::unique_ptr<MemoryBuffer>> Files;
+  std::vector<std::unique_ptr<object::Archive>> Archives;
+};
+
+} // anonymous namespace
+
+static void printError(const Twine &Filename, Error Err) {
+  printMessage("cfg-extract: " + Filename + ": " + toString(std::move(Err)));
+}
+
+// Add the bitcode members of an archive. Members without bitcode (e.g.,
+// objects compiled from assembly) are skipped. Members are named
+// `archive(member)`, as by other LLVM tools
+static bool addArchive(const std::string &Filename, MemoryBufferRef Buffer,
+                       Inputs &In) {
+  auto ArchiveOrErr = object::Archive::create(Buffer);
+  if (!ArchiveOrErr) {
+    printError(Filename, ArchiveOrErr.takeError());
+    return false;
+  }
+
+  Error Err = Error::success();
+  for (const auto &Child : (*ArchiveOrErr)->children(Err)) {
+    auto NameOrErr = Child.getName();
+    auto MemberOrErr = Child.getMemoryBufferRef();
+    if (!NameOrErr || !MemberOrErr) {
+      printError(Filename, joinErrors(NameOrErr.takeError(),
+                                      MemberOrErr.takeError()));
+      continue;
+    }
+
+    auto BitcodeOrErr = object::IRObjectFile::findBitcodeInMemBuffer(
+        *MemberOrErr);
+    if (!BitcodeOrErr) {
+      consumeError(BitcodeOrErr.takeError());
+      continue;
+    }
+
+    // Thin archive members are named by their path
+    const auto MemberName = sys::path::filename(*NameOrErr);
+    In.Modules.push_back({(Filename + "(" + MemberName + ")").str(),
+                          BitcodeOrErr->getBuffer()});
+  }
+  In.Archives.push_back(std::move(*ArchiveOrErr));
+
+  if (Err) {
+    printError(Filename, std::move(Err));
+    return false;
+  }
+  return true;
+}
+
+// Map an input file, and add the modules that it contains
+static bool addFile(const std::string &Filename, Inputs &In) {
+  auto FileOrErr = MemoryBuffer::getFile(Filename);
+  if (!FileOrErr) {
+    printError(Filename, errorCodeToError(FileOrErr.getError()));
+    return false;
+  }
+  const auto Buffer = (*FileOrErr)->getMemBufferRef();
+  In.Files.push_back(std::move(*FileOrErr));
+
+  switch (identify_magic(Buffer.getBuffer())) {
+  case file_magic::archive:
+    return addArchive(Filename, Buffer, In);
+  case file_magic::unknown:
+    // Textual IR
+    In.Modules.push_back({Filename, Buffer.getBuffer()});
+    return true;
+  default: {
+    // Bitcode, or an object file with embedded bitcode
+    auto BitcodeOrErr = object::IRObjectFile::findBitcodeInMemBuffer(Buffer);
+    if (!BitcodeOrErr) {
+      printError(Filename, BitcodeOrErr.takeError());
+      return false;
+    }
+    In.Modules.push_back({Filename, BitcodeOrErr->getBuffer()});
+    return true;
+  }
+  }
+}
+
+// Outputs are named after the file name of their module, which inputs can
+// share: same-named archive members, or files in different directories. Rather
+// than have their outputs overwrite each other, each input after the first
+// with a given name has its outputs numbered (e.g., `foo.bc` and `foo.bc.2`)
+static void nameOutputs(std::vector<ModuleInput> &Modules) {
+  StringSet<> Taken;
+  for (auto &Input : Modules) {
+    const auto Name = sys::path::filename(Input.Name);
+    if (Taken.insert(Name).second) {
+      continue;
+    }
+
+    unsigned N = 2;
+    do {
+      Input.OutputName = (Name + "." + Twine(N++)).str();
+    } while (!Taken.insert(Input.OutputName).second);
+    printMessage("cfg-extract: " + Input.Name + ": output named after '" +
+                 Input.OutputName + "', as '" + Name +
+                 "' is taken by another input");
+  }
+}
+
+// Parse and extract a single module. Returns false if it could not be parsed
+static bool extractModule(const ModuleInput &Input) {
+  // A context per module (rather than one per thread, reused) keeps memory from
+  // growing with every module a thread has parsed
+  LLVMContext Ctx;
+  SMDiagnostic Err;
+  auto M = getLazyIRModule(
+      MemoryBuffer::getMemBuffer(MemoryBufferRef(Input.Data, Input.Name),
+                                 /* RequiresNullTerminator */ false),
+      Err, Ctx, /* ShouldLazyLoadMetadata */ true);
+  if (!M) {
+    std::string Msg;
+    raw_string_ostream OS(Msg);
+    Err.print("cfg-extract", OS, /* ShowColors */ false);
+    printMessage(StringRef(OS.str()).rtrim());
+    return false;
+  }
+
+  legacy::PassManager PM;
+  PM.add(createCFGToJSONPass(Input.OutputName));
+  PM.run(*M);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Export the CFGs of bitcode files to JSON\n");
+
+  // Modules are not compiled, so there would be no object file to embed in
+  if (embedsOutput()) {
+    printMessage("cfg-extract: -cfg-embed is not supported, as modules are "
+                 "not compiled (use -cfg-format=binary instead)");
+    return 1;
+  }
+
+  // Analyses the pass may require (e.g., block frequencies for -cfg-order)
+  auto &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+
+  // Archives and object files are only scanned for their bitcode here, which is
+  // cheap; modules are parsed by the workers
+  Inputs In;
+  std::atomic<bool> Failed(false);
+  for (const auto &Filename : InputFilenames) {
+    if (!addFile(Filename, In)) {
+      Failed = true;
+    }
+  }
+  nameOutputs(In.Modules);
+
+  size_t Threads = NumThreads;
+  if (!Threads) {
+    Threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  Threads = std::min(Threads, In.Modules.size());
+
+  // Workers take the next module until there are none left, so that a few
+  // large modules do not hold up the rest
+  std::atomic<size_t> NextModule(0);
+  auto Work = [&]() {
+    for (size_t I = NextModule++; I < In.Modules.size(); I = NextModule++) {
+      if (!extractModule(In.Modules[I])) {
+        Failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> Workers;
+  for (size_t I = 1; I < Threads; ++I) {
+    Workers.emplace_back(Work);
+  }
+  Work();
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+
+  return Failed ? 1 : 0;
+}
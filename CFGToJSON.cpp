@@ -12,237 +12,864 @@
 ///
 //===----------------------------------------------------------------------===//
 
-#include "llvm/IR/CFG.h"
-#include "llvm/IR/Function.h"
-#include "llvm/IR/InlineAsm.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/IntrinsicInst.h"
+#include "CFGToJSON.h"
+#include "CFGEmitters.h"
+#include "CFGWalker.h"
+
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Chrono.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/GlobPattern.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/FunctionComparator.h"
 
 #include "json/json.h"
 
+#include <mutex>
+#include <type_traits>
+
 using namespace llvm;
+using namespace cfgtojson;
 
 #define DEBUG_TYPE "cfg-to-json"
 
 namespace {
 
-using SourceRange = std::pair<DebugLoc, DebugLoc>;
-
 cl::opt<std::string> OutDir("cfg-outdir", cl::desc("Output directory"),
                             cl::value_desc("directory"), cl::init("."));
 
-// Not available in older LLVM versions
-static std::string getNameOrAsOperand(const Value *V) {
-  if (!V->getName().empty()) {
-    return std::string(V->getName());
-  }
-
-  std::string BBName;
-  raw_string_ostream OS(BBName);
-  V->printAsOperand(OS, false);
-  return OS.str();
-}
-
-// Adapted from seadsa
-static const Value *getCalledFunctionThroughAliasesAndCasts(const Value *V) {
-  const Value *CalledV = V->stripPointerCasts();
-
-  if (const Function *F = dyn_cast<const Function>(CalledV)) {
-    return F;
-  }
-
-  if (const GlobalAlias *GA = dyn_cast<const GlobalAlias>(CalledV)) {
-    if (const Function *F =
-            dyn_cast<const Function>(GA->getAliasee()->stripPointerCasts())) {
-      return F;
-    }
-  }
+enum OutputFormat { FormatJSON, FormatBinary, FormatSummary };
+
+cl::opt<OutputFormat> Format(
+    "cfg-format", cl::desc("Output format"),
+    cl::values(clEnumValN(FormatJSON, "json", "JSON (cfg.*.json)"),
+               clEnumValN(FormatBinary, "binary",
+                          "Compact binary format (cfg.*.bin)"),
+               clEnumValN(FormatSummary, "summary",
+                          "Per-function counts only (cfg.*.summary.json)")),
+    cl::init(FormatJSON));
+
+enum OutputMode { ModeFull, ModeCallGraph };
+
+cl::opt<OutputMode> Mode(
+    "cfg-mode", cl::desc("What to export"),
+    cl::values(clEnumValN(ModeFull, "full",
+                          "Basic blocks, intra- and inter-procedural edges"),
+               clEnumValN(ModeCallGraph, "callgraph",
+                          "Function-level call graph only")),
+    cl::init(ModeFull));
+
+cl::opt<bool>
+    ShareShapes("cfg-share-shapes",
+                cl::desc("Emit structurally-identical function CFGs once and "
+                         "reference them from each function"),
+                cl::init(false));
+
+cl::opt<bool> DedupODR(
+    "cfg-dedup-odr",
+    cl::desc("Only emit linkonce_odr/weak_odr function CFGs once across all "
+             "modules written to the output directory"),
+    cl::init(false));
+
+cl::opt<bool> EmitLineIndex(
+    "cfg-line-index",
+    cl::desc("Emit an index from source (file, line) to basic blocks"),
+    cl::init(false));
+
+cl::opt<bool> EmitDistances(
+    "cfg-distances",
+    cl::desc("Emit the shortest intra-procedural distance from each "
+             "function's entry and call sites to its returns"),
+    cl::init(false));
+
+cl::opt<bool> CompactJSON(
+    "cfg-compact",
+    cl::desc("Write JSON without whitespace, through a buffered writer"),
+    cl::init(false));
+
+cl::list<std::string> FunctionFilter(
+    "cfg-functions",
+    cl::desc("Only export the functions whose names match one of these glob "
+             "patterns"),
+    cl::value_desc("pattern"), cl::CommaSeparated);
+
+enum FunctionOrderKind {
+  OrderModule,
+  OrderEntryCount,
+  OrderBlockFreq,
+  OrderSCC
+};
 
-  return CalledV;
-}
+cl::opt<FunctionOrderKind> FunctionOrder(
+    "cfg-order", cl::desc("Order of the output functions"),
+    cl::values(clEnumValN(OrderModule, "module", "Module order"),
+               clEnumValN(OrderEntryCount, "entry-count",
+                          "Hottest first, by profile entry count"),
+               clEnumValN(OrderBlockFreq, "block-freq",
+                          "Hottest first, by estimated block execution count "
+                          "(from the profile entry count and block "
+                          "frequencies)"),
+               clEnumValN(OrderSCC, "scc",
+                          "Grouped by call graph SCC, in reverse topological "
+                          "order (callees first)")),
+    cl::init(OrderModule));
+
+enum CASKeyKind { CASKeyOutput, CASKeyModule };
+
+cl::opt<std::string>
+    CASDir("cfg-cas",
+           cl::desc("Write outputs to a content-addressed store, and only "
+                    "write references to them to the output directory"),
+           cl::value_desc("directory"));
+
+cl::opt<CASKeyKind> CASKey(
+    "cfg-cas-key",
+    cl::desc("How to key outputs in the content-addressed store"),
+    cl::values(clEnumValN(CASKeyOutput, "output", "Hash of the output"),
+               clEnumValN(CASKeyModule, "module",
+                          "Hash of the module's bitcode (skips extraction if "
+                          "the module is already stored)")),
+    cl::init(CASKeyOutput));
+
+cl::opt<bool> Embed(
+    "cfg-embed",
+    cl::desc("Embed the CFG (in the binary format) in the object file's "
+             ".llvm_cfg section, rather than writing it to the output "
+             "directory"),
+    cl::init(false));
+
+cl::opt<bool> EmitManifest(
+    "cfg-manifest",
+    cl::desc("Append a record of each output to a manifest in the output "
+             "directory"),
+    cl::init(false));
+
+// Name of the section that CFGs are embedded in
+constexpr const char *EmbedSection = ".llvm_cfg";
+
+// Name of the ODR function registry directory (relative to the output
+// directory)
+constexpr const char *ODRRegistryDir = "cfg-odr";
+
+// Name of the output manifest (relative to the output directory)
+constexpr const char *ManifestFile = "cfg-manifest.jsonl";
 
 class CFGToJSON : public ModulePass {
 public:
   static char ID;
-  CFGToJSON() : ModulePass(ID) {}
+  explicit CFGToJSON(StringRef OutputName = "")
+      : ModulePass(ID), OutputName(OutputName) {}
 
   virtual void getAnalysisUsage(AnalysisUsage &) const override;
   virtual void print(raw_ostream &, const Module *) const override;
   virtual bool runOnModule(Module &) override;
+
+private:
+  template <typename EmitterT> void extract(Module &, EmitterT &);
+  uint64_t getFunctionWeight(Function &);
+
+  // The name that outputs are named after
+  StringRef getOutputName(const Module &M) const {
+    return OutputName.empty() ? sys::path::filename(M.getName())
+                              : StringRef(OutputName);
+  }
+
+  std::string OutputName;
+};
+
+// Call graph of the direct calls between functions defined in a module. The
+// first node is a synthetic root that calls every function, so that a
+// traversal from the root visits every function
+struct DirectCallGraph {
+  struct Node {
+    const Function *F;
+    SmallVector<Node *, 4> Callees;
+  };
+
+  std::vector<Node> Nodes;
+};
+
+// Passes output through to another stream, hashing it on the way (for the
+// manifest), so that the output need not be buffered or read back
+class HashingOStream : public raw_ostream {
+public:
+  explicit HashingOStream(raw_ostream &OS) : OS(OS) { SetUnbuffered(); }
+
+  MD5::MD5Result hash() {
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    return Result;
+  }
+
+private:
+  void write_impl(const char *Ptr, size_t Size) override {
+    Hash.update(StringRef(Ptr, Size));
+    OS.write(Ptr, Size);
+    Pos += Size;
+  }
+
+  uint64_t current_pos() const override { return Pos; }
+
+  raw_ostream &OS;
+  MD5 Hash;
+  uint64_t Pos = 0;
 };
 
 } // anonymous namespace
 
+namespace llvm {
+template <> struct GraphTraits<DirectCallGraph *> {
+  using NodeRef = DirectCallGraph::Node *;
+  using ChildIteratorType = SmallVectorImpl<NodeRef>::iterator;
+
+  static NodeRef getEntryNode(DirectCallGraph *G) { return &G->Nodes.front(); }
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->Callees.begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) { return N->Callees.end(); }
+};
+} // namespace llvm
+
 char CFGToJSON::ID = 0;
 
-// Adapted from llvm::CFGPrinter::getSimpleNodeLabel
-static std::string getBBLabel(const BasicBlock *BB) {
-  if (!BB->getName().empty()) {
-    return BB->getName().str();
+// Number each function by its call graph SCC. SCCs are numbered in reverse
+// topological order (i.e., callees before callers)
+static DenseMap<const Function *, unsigned> getSCCIds(const Module &M) {
+  DirectCallGraph CG;
+  DenseMap<const Function *, DirectCallGraph::Node *> FuncNodes;
+
+  // Reserve up front so that node pointers remain stable
+  CG.Nodes.reserve(M.size() + 1);
+  auto &Root = CG.Nodes.emplace_back(DirectCallGraph::Node{nullptr, {}});
+  for (const auto &F : M) {
+    if (!F.isDeclaration()) {
+      auto &N = CG.Nodes.emplace_back(DirectCallGraph::Node{&F, {}});
+      FuncNodes[&F] = &N;
+      Root.Callees.push_back(&N);
+    }
   }
 
-  std::string Str;
-  raw_string_ostream OS(Str);
+  for (auto &N : drop_begin(CG.Nodes, 1)) {
+    for (const auto &BB : *N.F) {
+      for (const auto &I : BB) {
+        const auto *CB = dyn_cast<CallBase>(&I);
+        if (!CB || CB->isIndirectCall()) {
+          continue;
+        }
 
-  BB->printAsOperand(OS, false);
+        const auto *Target =
+            getCalledFunctionThroughAliasesAndCasts(CB->getCalledOperand());
+        if (auto *Callee = FuncNodes.lookup(dyn_cast<Function>(Target))) {
+          N.Callees.push_back(Callee);
+        }
+      }
+    }
+  }
+
+  DenseMap<const Function *, unsigned> SCCIds;
+  unsigned SCCId = 0;
+  for (auto SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC) {
+    // The root is in its own SCC (nothing calls it)
+    if ((*SCC).front()->F == nullptr) {
+      continue;
+    }
+
+    for (const auto *N : *SCC) {
+      SCCIds[N->F] = SCCId;
+    }
+    SCCId++;
+  }
+
+  return SCCIds;
+}
+
+// Try to claim an ODR function in the registry shared by all modules written to
+// the output directory. The claim is made by atomically creating a file named
+// after the function's symbol and structural hash, so concurrent compilations
+// need no locking. `JLocation` says where the module's output is found (see
+// extract). Returns true if this module should emit the function (it claimed it
+// first, it claimed it in a previous build, or the registry is unavailable).
+// `Key` is set to the name of the function's registry entry
+static bool claimODRFunction(Function &F, const Module &M,
+                             const Json::Value &JLocation, std::string &Key) {
+  const auto &Name = getNameOrAsOperand(&F);
+  Key = utohexstr(xxHash64(Name)) + "." +
+        utohexstr(FunctionComparator::functionHash(F));
+
+  SmallString<64> Path(OutDir.c_str());
+  sys::path::append(Path, ODRRegistryDir, Key + ".json");
+
+  Json::Value JClaim = JLocation;
+  JClaim["name"] = Name;
+  JClaim["module"] = M.getName().str();
+
+  int FD;
+  if (auto EC = sys::fs::openFileForWrite(Path, FD, sys::fs::CD_CreateNew)) {
+    if (EC != std::errc::file_exists) {
+      return true;
+    }
+
+    // When a module is rebuilt, its output (which the claim points to) is
+    // overwritten, so it must emit the functions it claimed last time again.
+    // A claim that cannot be read (e.g., because it is still being written) is
+    // another module's
+    auto ClaimOrErr = MemoryBuffer::getFile(Path);
+    if (!ClaimOrErr) {
+      return false;
+    }
+
+    Json::Value JExisting;
+    Json::CharReaderBuilder Builder;
+    std::unique_ptr<Json::CharReader> Reader(Builder.newCharReader());
+    const auto &Buffer = (*ClaimOrErr)->getBuffer();
+    if (!Reader->parse(Buffer.begin(), Buffer.end(), &JExisting, nullptr)) {
+      return false;
+    }
+
+    return JExisting == JClaim;
+  }
+
+  raw_fd_ostream Claim(FD, /* shouldClose */ true);
+  Claim << JClaim.toStyledString();
+
+  return true;
+}
+
+// The -cfg-functions patterns. Patterns that are not valid globs are reported
+// and ignored
+static SmallVector<GlobPattern, 1> getFunctionFilter() {
+  SmallVector<GlobPattern, 1> Patterns;
+  for (const auto &Pattern : FunctionFilter) {
+    if (auto Glob = GlobPattern::create(Pattern)) {
+      Patterns.push_back(std::move(*Glob));
+    } else {
+      printMessage("Invalid function pattern '" + Pattern +
+                   "': " + toString(Glob.takeError()));
+    }
+  }
+  return Patterns;
+}
+
+// Release the body of a lazily-loaded function once it has been extracted, so
+// that only one function body need be in memory at a time. The function is
+// left materializable (with its original linkage), so that the functions that
+// call it still see a definition rather than an external declaration
+static void dematerialize(Function &F) {
+  const auto Linkage = F.getLinkage();
+  F.deleteBody();
+  F.setLinkage(Linkage);
+  F.setIsMaterializable(true);
+}
+
+// Embed the output in the module's object file, in a section that is not
+// loaded at run time. The linker concatenates the sections of the objects that
+// it links, so a linked binary holds the CFGs of all of its modules, one after
+// the other. The section is emitted through module-level inline assembly
+// (which is ELF-specific), because global variables are always placed in
+// allocated sections
+static void embedOutput(Module &M, StringRef Out) {
+  std::string Asm;
+  raw_string_ostream OS(Asm);
+  OS << ".pushsection " << EmbedSection << ",\"\",@progbits\n";
+  for (size_t I = 0; I < Out.size(); I += 64) {
+    OS << ".ascii \"";
+    for (unsigned char C : Out.substr(I, 64)) {
+      if (isPrint(C) && C != '"' && C != '\\') {
+        OS << C;
+      } else {
+        OS << '\\' << char('0' + (C >> 6)) << char('0' + ((C >> 3) & 7))
+           << char('0' + (C & 7));
+      }
+    }
+    OS << "\"\n";
+  }
+  OS << ".popsection";
+
+  M.appendModuleInlineAsm(OS.str());
+}
+
+// Options that change the output for a given module. Used to key the
+// content-addressed store by module
+static std::string getOutputConfig() {
+  std::string Config;
+  raw_string_ostream OS(Config);
+  OS << "format=" << Format << ",mode=" << Mode
+     << ",share-shapes=" << ShareShapes << ",line-index=" << EmitLineIndex
+     << ",distances=" << EmitDistances << ",order=" << FunctionOrder
+     << ",compact=" << CompactJSON;
+  if (!FunctionFilter.empty()) {
+    OS << ",functions=" << join(FunctionFilter, ",");
+  }
   return OS.str();
 }
 
-static SourceRange getSourceRange(const BasicBlock *BB) {
-  DebugLoc Start;
-  for (const auto &I : *BB) {
-    const auto &DbgLoc = I.getDebugLoc();
-    if (DbgLoc) {
-      Start = DbgLoc;
-      break;
+// The output names the module, so the module identifier (which the bitcode does
+// not include) is part of the key
+static std::string getModuleCASKey(const Module &M) {
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  WriteBitcodeToFile(M, OS);
+  OS << getOutputConfig() << ",module=" << M.getModuleIdentifier();
+
+  return utohexstr(xxHash64(StringRef(Buffer.data(), Buffer.size())));
+}
+
+static SmallString<128> getCASPath(StringRef Key, StringRef Extension) {
+  SmallString<128> Path(CASDir.c_str());
+  sys::fs::make_absolute(Path);
+  sys::path::append(Path, Key.take_front(2), Key + "." + Extension);
+  return Path;
+}
+
+// Write to a temporary file and rename it, so that readers (and other writers)
+// of the same path never see a partially-written file
+static std::error_code writeFileAtomically(StringRef Path, StringRef Data) {
+  if (auto EC = sys::fs::create_directories(sys::path::parent_path(Path))) {
+    return EC;
+  }
+
+  int FD;
+  SmallString<128> TmpPath;
+  if (auto EC = sys::fs::createUniqueFile(Path + ".tmp-%%%%%%", FD, TmpPath)) {
+    return EC;
+  }
+
+  {
+    raw_fd_ostream File(FD, /* shouldClose */ true);
+    File << Data;
+    File.close();
+    if (File.has_error()) {
+      auto EC = File.error();
+      File.clear_error();
+      sys::fs::remove(TmpPath);
+      return EC;
     }
   }
 
-  return {Start, BB->getTerminator()->getDebugLoc()};
+  if (auto EC = sys::fs::rename(TmpPath, Path)) {
+    sys::fs::remove(TmpPath);
+    return EC;
+  }
+
+  return {};
+}
+
+// Write a reference to the module's content-addressed output to the output
+// directory
+static void writeCASRef(const Module &M, StringRef ModName, StringRef Key,
+                        StringRef CASPath) {
+  SmallString<32> Filename(OutDir.c_str());
+  sys::path::append(Filename, "cfg." + ModName + ".ref");
+
+  Json::Value JRef;
+  JRef["module"] = M.getName().str();
+  JRef["key"] = Key.str();
+  JRef["path"] = CASPath.str();
+
+  std::error_code EC;
+  raw_fd_ostream File(Filename, EC, sys::fs::F_Text);
+
+  if (!EC) {
+    File << JRef.toStyledString();
+  } else {
+    printMessage("Unable to write reference '" + Filename +
+                 "': " + EC.message());
+  }
+}
+
+// A path relative to the output directory (e.g., `../cas/AB/AB12.json` for an
+// output in a store next to it)
+static std::string getPathInOutDir(StringRef Path) {
+  SmallString<128> AbsPath(Path), AbsOutDir(OutDir.c_str());
+  for (auto *P : {&AbsPath, &AbsOutDir}) {
+    sys::fs::make_absolute(*P);
+    sys::path::remove_dots(*P, /* remove_dot_dot */ true);
+  }
+
+  auto PathIt = sys::path::begin(AbsPath), PathEnd = sys::path::end(AbsPath);
+  auto DirIt = sys::path::begin(AbsOutDir), DirEnd = sys::path::end(AbsOutDir);
+  while (PathIt != PathEnd && DirIt != DirEnd && *PathIt == *DirIt) {
+    ++PathIt;
+    ++DirIt;
+  }
+
+  SmallString<128> Relative;
+  for (; DirIt != DirEnd; ++DirIt) {
+    sys::path::append(Relative, "..");
+  }
+  for (; PathIt != PathEnd; ++PathIt) {
+    sys::path::append(Relative, *PathIt);
+  }
+  return Relative.str().str();
+}
+
+// Append a record of a module's output to the manifest in the output directory,
+// so that consumers can find all outputs in a single read, rather than by
+// listing the directory. Each record is a line of JSON, written with a single
+// write to the manifest opened with O_APPEND, so that records appended by
+// concurrent compilations are never interleaved. Outputs are recorded by their
+// path relative to the output directory, wherever they are stored
+static void appendToManifest(const Module &M, StringRef Path, uint64_t Size,
+                             const MD5::MD5Result &Hash) {
+  Json::Value JRecord;
+  JRecord["module"] = M.getName().str();
+  JRecord["file"] = getPathInOutDir(Path);
+  JRecord["size"] = Json::UInt64(Size);
+  JRecord["md5"] = Hash.digest().str().str();
+  JRecord["time"] =
+      Json::Int64(sys::toTimeT(std::chrono::system_clock::now()));
+
+  Json::StreamWriterBuilder Builder;
+  Builder["indentation"] = "";
+  const auto Record = Json::writeString(Builder, JRecord) + "\n";
+
+  SmallString<32> ManifestPath(OutDir.c_str());
+  sys::path::append(ManifestPath, ManifestFile);
+
+  int FD;
+  if (auto EC = sys::fs::openFileForWrite(ManifestPath, FD,
+                                          sys::fs::CD_OpenAlways,
+                                          sys::fs::F_Append)) {
+    printMessage("Unable to open manifest '" + ManifestPath +
+                 "': " + EC.message());
+    return;
+  }
+
+  raw_fd_ostream Manifest(FD, /* shouldClose */ true, /* unbuffered */ true);
+  Manifest << Record;
+}
+
+// Record an output already in the content-addressed store. Its size and hash
+// are taken from the stored file
+static void appendStoredToManifest(const Module &M, StringRef Path) {
+  uint64_t Size = 0;
+  auto HashOrErr = sys::fs::md5_contents(Path);
+  if (auto EC = HashOrErr ? sys::fs::file_size(Path, Size)
+                          : HashOrErr.getError()) {
+    printMessage("Unable to read '" + Path + "' for the manifest: " +
+                 EC.message());
+    return;
+  }
+  appendToManifest(M, Path, Size, *HashOrErr);
+}
+
+static void writeToCAS(const Module &M, StringRef ModName, StringRef Key,
+                       StringRef Extension, StringRef Out) {
+  const auto &Path = getCASPath(Key, Extension);
+
+  std::string Status;
+  if (sys::fs::exists(Path)) {
+    Status = "  already stored";
+  } else if (auto EC = writeFileAtomically(Path, Out)) {
+    Status = "  error writing to store: " + EC.message();
+  }
+  printMessage("Writing module '" + M.getName() + "' to '" + Path + "'..." +
+               Status);
+
+  writeCASRef(M, ModName, Key, Path);
+  if (EmitManifest && sys::fs::exists(Path)) {
+    MD5 Hash;
+    Hash.update(Out);
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    appendToManifest(M, Path, Out.size(), Result);
+  }
 }
 
 void CFGToJSON::getAnalysisUsage(AnalysisUsage &AU) const {
+  if (FunctionOrder == OrderBlockFreq) {
+    AU.addRequired<BlockFrequencyInfoWrapperPass>();
+  }
   AU.setPreservesAll();
 }
 
+// How hot a function is, according to the requested function order. Functions
+// without a profile have a weight of zero
+uint64_t CFGToJSON::getFunctionWeight(Function &F) {
+  const auto &EntryCount = F.getEntryCount();
+  if (!EntryCount) {
+    return 0;
+  }
+
+  if (FunctionOrder == OrderEntryCount) {
+    return EntryCount->getCount();
+  }
+
+  const auto &BFI = getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
+  uint64_t Weight = 0;
+  for (const auto &BB : F) {
+    if (const auto &Count = BFI.getBlockProfileCount(&BB)) {
+      Weight += *Count;
+    }
+  }
+  return Weight;
+}
+
 void CFGToJSON::print(raw_ostream &OS, const Module *M) const {
   // Nothing to do here
 }
 
 bool CFGToJSON::runOnModule(Module &M) {
-  SmallPtrSet<const BasicBlock *, 32> SeenBBs;
-  SmallVector<const BasicBlock *, 32> Worklist;
+  // The JSON values built by the emitters are allocated in an arena, so that
+  // they are released all at once (rather than one by one) when it is
+  // destroyed, after the emitter
+  Json::Arena Arena;
+  Json::Arena::Scope ArenaScope(Arena);
+
+  // Embedded CFGs are concatenated by the linker, so they are always in the
+  // (self-delimiting) binary format
+  const auto ModFormat = Embed ? FormatBinary : Format;
+  if (ModFormat != FormatJSON) {
+    for (const auto *Opt : {&ShareShapes, &EmitLineIndex, &EmitDistances}) {
+      if (*Opt) {
+        printMessage("-" + Opt->ArgStr +
+                     " only applies to the JSON format, ignoring it");
+      }
+    }
+  }
 
-  Json::Value JFuncs, JBlocks, JEdges, JCalls, JUnresolvedCalls, JReturns;
+  switch (ModFormat) {
+  case FormatJSON: {
+    JSONEmitter::Options Opts;
+    Opts.CallGraph = Mode == ModeCallGraph;
+    Opts.ShareShapes = ShareShapes;
+    Opts.LineIndex = EmitLineIndex;
+    Opts.Distances = EmitDistances;
+    Opts.Compact = CompactJSON;
+
+    JSONEmitter E(Opts);
+    extract(M, E);
+    break;
+  }
+  case FormatBinary: {
+    BinaryEmitter E;
+    extract(M, E);
+    break;
+  }
+  case FormatSummary: {
+    SummaryEmitter E(CompactJSON);
+    extract(M, E);
+    break;
+  }
+  }
 
-  for (const auto &F : M) {
-    if (F.isDeclaration()) {
-      continue;
+  return Embed;
+}
+
+template <typename EmitterT>
+void CFGToJSON::extract(Module &M, EmitterT &E) {
+  const auto ModName = getOutputName(M);
+  SmallString<32> Filename(OutDir.c_str());
+  sys::path::append(Filename, "cfg." + ModName + "." + EmitterT::Extension);
+
+  // When keyed by module, the output is already stored if the module has been
+  // seen before. However, the ODR registry makes the output depend on other
+  // modules, so in that case fall back to keying by output
+  const bool KeyByModule =
+      !Embed && !CASDir.empty() && CASKey == CASKeyModule && !DedupODR;
+
+  // Only ELF objects can embed the output (otherwise it is written as usual)
+  const bool Embedded =
+      Embed && Triple(M.getTargetTriple()).isOSBinFormatELF();
+
+  // Ordering by SCC needs every function's calls up front, and keying by module
+  // hashes its bitcode, so a lazily-loaded module (e.g., from cfg-extract) is
+  // materialized in full for those. Otherwise, function bodies are loaded one
+  // at a time as they are extracted
+  if (FunctionOrder == OrderSCC || KeyByModule) {
+    if (auto Err = M.materializeAll()) {
+      printMessage("Unable to load module '" + M.getName() +
+                   "': " + toString(std::move(Err)));
+      return;
     }
-    SeenBBs.clear();
-    Worklist.clear();
-    Worklist.push_back(&F.getEntryBlock());
+  }
 
-    JBlocks.clear();
-    JEdges.clear();
-    JCalls.clear();
-    JUnresolvedCalls.clear();
-    JReturns.clear();
+  std::string Key;
+  if (KeyByModule) {
+    Key = getModuleCASKey(M);
+
+    const auto &Path = getCASPath(Key, EmitterT::Extension);
+    if (sys::fs::exists(Path)) {
+      printMessage("Module '" + M.getName() + "' already stored at '" + Path +
+                   "'");
+      writeCASRef(M, ModName, Key, Path);
+      if (EmitManifest) {
+        appendStoredToManifest(M, Path);
+      }
+      return;
+    }
+  }
 
-    while (!Worklist.empty()) {
-      auto *BB = Worklist.pop_back_val();
+  // Where the output is found, recorded by the ODR registry: the object file's
+  // section, the reference to the output in the store, or the output file
+  // (files relative to the output directory)
+  Json::Value JLocation;
+  if (DedupODR) {
+    SmallString<32> RegistryDir(OutDir.c_str());
+    sys::path::append(RegistryDir, ODRRegistryDir);
+    if (auto EC = sys::fs::create_directories(RegistryDir)) {
+      printMessage("Unable to create ODR registry '" + RegistryDir +
+                   "': " + EC.message());
+    }
 
-      // Prevent loops
-      if (!SeenBBs.insert(BB).second) {
-        continue;
-      }
+    if (Embedded) {
+      JLocation["section"] = EmbedSection;
+    } else if (!CASDir.empty()) {
+      JLocation["file"] = ("cfg." + ModName + ".ref").str();
+    } else {
+      JLocation["file"] = sys::path::filename(Filename).str();
+    }
+  }
 
-      // Save the basic block
-      const auto &BBLabel = getBBLabel(BB);
-      const auto &[SrcStart, SrcEnd] = getSourceRange(BB);
+  // Function weights or SCC ids (used for ordering), in emission order
+  SmallVector<uint64_t, 0> FuncOrderKeys;
+  DenseMap<const Function *, unsigned> SCCIds;
+  if (FunctionOrder == OrderSCC) {
+    SCCIds = getSCCIds(M);
+  }
 
-      Json::Value JBlock;
-      JBlock["start_line"] = SrcStart ? SrcStart.getLine() : Json::Value();
-      JBlock["end_line"] = SrcEnd ? SrcEnd.getLine() : Json::Value();
-      JBlocks[BBLabel] = JBlock;
+  CFGWalker<EmitterT> Walker(E);
 
-      // Save the intra-procedural edges
-      for (auto SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI) {
-        Json::Value JEdge;
-        JEdge["src"] = BBLabel;
-        JEdge["dst"] = getBBLabel(*SI);
-        JEdge["type"] = BB->getTerminator()->getOpcodeName();
-        JEdges.append(JEdge);
+  const auto Filter = getFunctionFilter();
 
-        Worklist.push_back(*SI);
-      }
+  for (auto &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
 
-      // Save the inter-procedural edges
-      for (auto &I : *BB) {
-        // Skip debug instructions
-        if (isa<DbgInfoIntrinsic>(&I)) {
-          continue;
-        }
+    if (!FunctionFilter.empty() &&
+        none_of(Filter, [&](const GlobPattern &Pattern) {
+          return Pattern.match(F.getName());
+        })) {
+      continue;
+    }
 
-        if (const auto *CB = dyn_cast<CallBase>(&I)) {
-          if (CB->isIndirectCall()) {
-            JUnresolvedCalls.append(BBLabel);
-          } else {
-            const auto *Target =
-                getCalledFunctionThroughAliasesAndCasts(CB->getCalledOperand());
-
-            Json::Value JCall;
-            JCall["src"] = BBLabel;
-            JCall["dst"] = [&Target]() {
-              if (const auto *IAsm = dyn_cast<InlineAsm>(Target)) {
-                return IAsm->getAsmString();
-              } else {
-                return getNameOrAsOperand(Target);
-              }
-            }();
-            JCall["type"] = I.getOpcodeName();
-
-            JCalls.append(JCall);
-          }
-        }
+    // Bodies are only loaded for the functions being extracted, and released
+    // once they have been (see dematerialize)
+    const bool Lazy = F.isMaterializable();
+    if (Lazy) {
+      if (auto Err = F.materialize()) {
+        printMessage("Unable to load function '" + F.getName() + "' in '" +
+                     M.getName() + "': " + toString(std::move(Err)));
+        continue;
       }
+    }
 
-      const auto *Term = BB->getTerminator();
-      assert(!isa<CatchSwitchInst>(Term) &&
-             "catchswitch instruction not yet supported");
-      assert(!isa<CatchReturnInst>(Term) &&
-             "catchret instruction not yet supported");
-      assert(!isa<CleanupReturnInst>(Term) &&
-             "cleanupret instruction not yet supported");
-      if (isa<ReturnInst>(Term) || isa<ResumeInst>(Term)) {
-        Json::Value JReturn;
-        JReturn["block"] = BBLabel;
-        JReturn["type"] = Term->getOpcodeName();
-
-        JReturns.append(JReturn);
-      }
+    if (FunctionOrder == OrderSCC) {
+      FuncOrderKeys.push_back(SCCIds.lookup(&F));
+    } else if (FunctionOrder != OrderModule) {
+      FuncOrderKeys.push_back(getFunctionWeight(F));
+    }
+
+    // If another module has already emitted this ODR function, only save a
+    // reference to its registry entry
+    std::string ODRKey;
+    if (DedupODR && (F.hasLinkOnceODRLinkage() || F.hasWeakODRLinkage()) &&
+        !claimODRFunction(F, M, JLocation, ODRKey)) {
+      E.functionRef(F, ODRKey);
+    } else if (Mode == ModeCallGraph) {
+      // The call graph does not need any basic block information
+      Walker.walkCallGraph(F);
+    } else {
+      Walker.walk(F);
     }
 
-    // Save function
-    Json::Value JFunc;
-    JFunc["name"] = getNameOrAsOperand(&F);
-    JFunc["entry"] = getBBLabel(&F.getEntryBlock());
-    JFunc["blocks"] = JBlocks;
-    JFunc["edges"] = JEdges;
-    JFunc["calls"] = JCalls;
-    JFunc["returns"] = JReturns;
-    JFunc["unresolved_calls"] = JUnresolvedCalls;
-    JFuncs.append(JFunc);
+    if (Lazy) {
+      dematerialize(F);
+    }
   }
 
-  // Print the results
-  Json::Value JMod;
-  JMod["module"] = M.getName().str();
-  JMod["functions"] = JFuncs;
+  // Either hottest functions first, or functions grouped by SCC (in increasing
+  // SCC id). Functions with equal keys remain in module order
+  if (FunctionOrder != OrderModule) {
+    const bool ByWeight = FunctionOrder != OrderSCC;
+    E.orderFunctions(FuncOrderKeys, /* Descending */ ByWeight,
+                     ByWeight ? "weight" : "scc");
+  }
 
-  const auto ModName = sys::path::filename(M.getName());
-  SmallString<32> Filename(OutDir.c_str());
-  sys::path::append(Filename, "cfg." + ModName + ".json");
-  errs() << "Writing module '" << M.getName() << "' to '" << Filename << "'...";
+  if (Embedded) {
+    std::string Out;
+    raw_string_ostream OS(Out);
+    E.finish(M, OS);
+    embedOutput(M, OS.str());
+
+    printMessage("Embedding module '" + M.getName() + "' in section '" +
+                 EmbedSection + "'...");
+    return;
+  }
+  if (Embed) {
+    printMessage("Unable to embed module '" + M.getName() +
+                 "' (only ELF targets are supported), writing it to the "
+                 "output directory instead");
+  }
+
+  // Print the results. The store needs the whole output (to hash it), while
+  // files are written as the output is produced
+  if (!CASDir.empty()) {
+    std::string Out;
+    raw_string_ostream OS(Out);
+    E.finish(M, OS);
+    OS.flush();
 
+    if (Key.empty()) {
+      Key = utohexstr(xxHash64(Out));
+    }
+    writeToCAS(M, ModName, Key, EmitterT::Extension, Out);
+    return;
+  }
+
+  // The emitter, rather than -cfg-format, decides the mode: -cfg-embed falls
+  // back to writing the binary format here
   std::error_code EC;
-  raw_fd_ostream File(Filename, EC, sys::fs::F_Text);
+  raw_fd_ostream File(Filename, EC,
+                      std::is_same<EmitterT, BinaryEmitter>::value
+                          ? sys::fs::F_None
+                          : sys::fs::F_Text);
+
+  if (EC) {
+    printMessage("Writing module '" + M.getName() + "' to '" + Filename +
+                 "'...  error opening file for writing!");
+    return;
+  }
 
-  if (!EC) {
-    File << JMod.toStyledString();
+  if (!EmitManifest) {
+    E.finish(M, File);
   } else {
-    errs() << "  error opening file for writing!";
+    // The output is recorded once it has been written in full
+    HashingOStream OS(File);
+    E.finish(M, OS);
+    File.close();
+    if (!File.has_error()) {
+      appendToManifest(M, Filename, OS.tell(), OS.hash());
+    }
   }
-  errs() << "\n";
+  printMessage("Writing module '" + M.getName() + "' to '" + Filename +
+               "'...");
+}
+
+ModulePass *cfgtojson::createCFGToJSONPass(StringRef OutputName) {
+  return new CFGToJSON(OutputName);
+}
+
+bool cfgtojson::embedsOutput() { return Embed; }
 
-  return false;
+void cfgtojson::printMessage(const Twine &Msg) {
+  static std::mutex Lock;
+  std::lock_guard<std::mutex> Guard(Lock);
+  errs() << Msg << "\n";
 }
 
 static RegisterPass<CFGToJSON> X("cfg-to-json", "Export a CFG to JSON", false,
@@ -250,7 +877,7 @@ static RegisterPass<CFGToJSON> X("cfg-to-json", "Export a CFG to JSON", false,
 
 static void registerCFGToJSON(const PassManagerBuilder &,
                               legacy::PassManagerBase &PM) {
-  PM.add(new CFGToJSON());
+  PM.add(createCFGToJSONPass());
 }
 
 static RegisterStandardPasses
@@ -0,0 +1,44 @@
+//===-- CFGToJSON.h - Export CFG to JSON ------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// The CFG to JSON pass, for tools that run it directly rather than loading it
+/// as a plugin (see CFGExtract.cpp).
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_TO_JSON_CFG_TO_JSON_H
+#define CFG_TO_JSON_CFG_TO_JSON_H
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class ModulePass;
+class Twine;
+} // namespace llvm
+
+namespace cfgtojson {
+
+// Create the pass. It is configured by the `-cfg-*` command-line options.
+// Outputs are named after `OutputName` (e.g., `cfg.<OutputName>.json`), or if
+// it is empty, after the module's file name
+llvm::ModulePass *createCFGToJSONPass(llvm::StringRef OutputName = "");
+
+// Whether the pass embeds its output in the module (`-cfg-embed`), which is
+// only written out if the module is then compiled
+bool embedsOutput();
+
+// Print a message to stderr, on its own line. Messages are printed in one
+// piece, under a lock, so that messages about modules extracted concurrently
+// are not interleaved
+void printMessage(const llvm::Twine &Msg);
+
+} // namespace cfgtojson
+
+#endif // CFG_TO_JSON_CFG_TO_JSON_H
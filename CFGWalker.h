@@ -0,0 +1,242 @@
+//===-- CFGWalker.h - Walk a CFG --------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Walks a function's control flow graph (CFG), including function calls, and
+/// reports what it finds to an emitter.
+///
+/// The emitter is a template parameter (rather than a virtual interface), so
+/// that emitter calls can be inlined into the walk. An emitter provides:
+///
+///   void beginFunction(const Function &F);
+///   void block(const BasicBlock *BB);
+///   void edge(const BasicBlock *Src, const BasicBlock *Dst);
+///   void calls(const BasicBlock *BB, const CallCounts &Calls,
+///              unsigned NumIndirectCalls);
+///   void ret(const BasicBlock *BB, const Instruction *Term);
+///   void endFunction(const Function &F);
+///   void callGraphNode(const Function &F, const CallCounts &Callees,
+///                      unsigned NumIndirectCalls);
+///
+/// A basic block's `edge`, `calls` and `ret` events always directly follow its
+/// `block` event.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_TO_JSON_CFG_WALKER_H
+#define CFG_TO_JSON_CFG_WALKER_H
+
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <utility>
+
+namespace cfgtojson {
+
+using SourceRange = std::pair<llvm::DebugLoc, llvm::DebugLoc>;
+
+// Number of calls to each callee, keyed by (callee, opcode)
+using CallCounts =
+    llvm::SmallMapVector<std::pair<const llvm::Value *, unsigned>, unsigned, 8>;
+
+// Not available in older LLVM versions
+inline std::string getNameOrAsOperand(const llvm::Value *V) {
+  if (!V->getName().empty()) {
+    return std::string(V->getName());
+  }
+
+  std::string BBName;
+  llvm::raw_string_ostream OS(BBName);
+  V->printAsOperand(OS, false);
+  return OS.str();
+}
+
+// Adapted from seadsa
+inline const llvm::Value *
+getCalledFunctionThroughAliasesAndCasts(const llvm::Value *V) {
+  const llvm::Value *CalledV = V->stripPointerCasts();
+
+  if (const auto *F = llvm::dyn_cast<const llvm::Function>(CalledV)) {
+    return F;
+  }
+
+  if (const auto *GA = llvm::dyn_cast<const llvm::GlobalAlias>(CalledV)) {
+    if (const auto *F = llvm::dyn_cast<const llvm::Function>(
+            GA->getAliasee()->stripPointerCasts())) {
+      return F;
+    }
+  }
+
+  return CalledV;
+}
+
+inline std::string getCalleeName(const llvm::Value *Target) {
+  if (const auto *IAsm = llvm::dyn_cast<llvm::InlineAsm>(Target)) {
+    return IAsm->getAsmString();
+  } else {
+    return getNameOrAsOperand(Target);
+  }
+}
+
+// Adapted from llvm::CFGPrinter::getSimpleNodeLabel
+inline std::string getBBLabel(const llvm::BasicBlock *BB) {
+  if (!BB->getName().empty()) {
+    return BB->getName().str();
+  }
+
+  std::string Str;
+  llvm::raw_string_ostream OS(Str);
+
+  BB->printAsOperand(OS, false);
+  return OS.str();
+}
+
+inline SourceRange getSourceRange(const llvm::BasicBlock *BB) {
+  llvm::DebugLoc Start;
+  for (const auto &I : *BB) {
+    const auto &DbgLoc = I.getDebugLoc();
+    if (DbgLoc) {
+      Start = DbgLoc;
+      break;
+    }
+  }
+
+  return {Start, BB->getTerminator()->getDebugLoc()};
+}
+
+template <typename EmitterT> class CFGWalker {
+public:
+  explicit CFGWalker(EmitterT &E) : E(E) {}
+
+  // Walk the basic blocks reachable from the function's entry. Repeated calls
+  // from a basic block to the same callee are only reported once (with an
+  // occurrence count)
+  void walk(const llvm::Function &F);
+
+  // Only report the direct callees and number of indirect calls of the basic
+  // blocks reachable from the function's entry
+  void walkCallGraph(const llvm::Function &F);
+
+private:
+  // Add the calls made by the basic block to `Calls` and `NumIndirectCalls`
+  void collectCalls(const llvm::BasicBlock &BB);
+
+  EmitterT &E;
+
+  llvm::SmallPtrSet<const llvm::BasicBlock *, 32> SeenBBs;
+  llvm::SmallVector<const llvm::BasicBlock *, 32> Worklist;
+  CallCounts Calls;
+  unsigned NumIndirectCalls = 0;
+};
+
+template <typename EmitterT>
+void CFGWalker<EmitterT>::collectCalls(const llvm::BasicBlock &BB) {
+  for (const auto &I : BB) {
+    // Skip debug instructions
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(&I)) {
+      continue;
+    }
+
+    if (const auto *CB = llvm::dyn_cast<llvm::CallBase>(&I)) {
+      if (CB->isIndirectCall()) {
+        NumIndirectCalls++;
+      } else {
+        const auto *Target =
+            getCalledFunctionThroughAliasesAndCasts(CB->getCalledOperand());
+        Calls[{Target, I.getOpcode()}]++;
+      }
+    }
+  }
+}
+
+template <typename EmitterT>
+void CFGWalker<EmitterT>::walk(const llvm::Function &F) {
+  SeenBBs.clear();
+  Worklist.clear();
+  Worklist.push_back(&F.getEntryBlock());
+
+  E.beginFunction(F);
+
+  while (!Worklist.empty()) {
+    auto *BB = Worklist.pop_back_val();
+
+    // Prevent loops
+    if (!SeenBBs.insert(BB).second) {
+      continue;
+    }
+
+    E.block(BB);
+
+    // Intra-procedural edges
+    for (auto SI = llvm::succ_begin(BB), SE = llvm::succ_end(BB); SI != SE;
+         ++SI) {
+      E.edge(BB, *SI);
+      Worklist.push_back(*SI);
+    }
+
+    // Inter-procedural edges
+    Calls.clear();
+    NumIndirectCalls = 0;
+    collectCalls(*BB);
+    if (!Calls.empty() || NumIndirectCalls) {
+      E.calls(BB, Calls, NumIndirectCalls);
+    }
+
+    const auto *Term = BB->getTerminator();
+    assert(!llvm::isa<llvm::CatchSwitchInst>(Term) &&
+           "catchswitch instruction not yet supported");
+    assert(!llvm::isa<llvm::CatchReturnInst>(Term) &&
+           "catchret instruction not yet supported");
+    assert(!llvm::isa<llvm::CleanupReturnInst>(Term) &&
+           "cleanupret instruction not yet supported");
+    if (llvm::isa<llvm::ReturnInst>(Term) ||
+        llvm::isa<llvm::ResumeInst>(Term)) {
+      E.ret(BB, Term);
+    }
+  }
+
+  E.endFunction(F);
+}
+
+template <typename EmitterT>
+void CFGWalker<EmitterT>::walkCallGraph(const llvm::Function &F) {
+  SeenBBs.clear();
+  Worklist.clear();
+  Worklist.push_back(&F.getEntryBlock());
+  Calls.clear();
+  NumIndirectCalls = 0;
+
+  while (!Worklist.empty()) {
+    auto *BB = Worklist.pop_back_val();
+
+    // Prevent loops
+    if (!SeenBBs.insert(BB).second) {
+      continue;
+    }
+
+    Worklist.append(llvm::succ_begin(BB), llvm::succ_end(BB));
+    collectCalls(*BB);
+  }
+
+  E.callGraphNode(F, Calls, NumIndirectCalls);
+}
+
+} // namespace cfgtojson
+
+#endif // CFG_TO_JSON_CFG_WALKER_H
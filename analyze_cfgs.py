@@ -8,11 +8,12 @@ Author: Adrian Herrera
 
 
 from argparse import ArgumentParser, Namespace
-from collections import Counter
 from pathlib import Path
 from typing import List, Optional, Set, Tuple
 import json
 import logging
+import mmap
+import struct
 
 import networkx as nx
 from networkx.drawing.nx_pydot import write_dot
@@ -21,13 +22,18 @@ from networkx.drawing.nx_pydot import write_dot
 logger = logging.getLogger(name=__name__)
 
 
+# Section that CFGs are embedded in (i.e., with `-cfg-embed`)
+EMBED_SECTION = b'.llvm_cfg'
+
+
 def parse_args() -> Namespace:
     """Parse command-line arguments."""
     parser = ArgumentParser(description='Analyze CFG(s)')
     parser.add_argument('-o', '--output', metavar='DOT', type=Path,
                         help='Path to output DOT')
-    parser.add_argument('cfg', metavar='JSON', nargs='+', type=Path,
-                        help='CFG JSON files')
+    parser.add_argument('cfg', metavar='CFG', nargs='+', type=Path,
+                        help='CFG JSON (or binary) files, or ELF files with '
+                             'embedded CFGs')
     return parser.parse_args()
 
 
@@ -41,12 +47,221 @@ def find_callee(modules: List[dict], callee: str) -> Tuple[Optional[str], dict]:
     for mod_data in modules:
         module = mod_data['module']
         for func_data in mod_data['functions']:
-            if callee == func_data['name']:
+            if callee == func_data['name'] and 'odr_ref' not in func_data:
                 return module, func_data
 
     return None, {}
 
 
+def expand_shapes(mod_data: dict) -> dict:
+    """
+    Expand functions that reference a shared shape (i.e., produced with
+    `-cfg-share-shapes`) back into self-contained function CFGs.
+    """
+    shapes = mod_data.get('shapes')
+    if not shapes:
+        return mod_data
+
+    for func_data in mod_data['functions']:
+        if 'shape' not in func_data:
+            continue
+
+        shape = shapes[func_data.pop('shape')]
+        lines = func_data.pop('lines')
+
+        func_data.update({key: val for key, val in shape.items()
+                          if key != 'blocks'})
+        func_data['blocks'] = {label: dict(start_line=start, end_line=end)
+                               for label, (start, end) in
+                               zip(shape['blocks'], lines)}
+
+    return mod_data
+
+
+class BinaryReader:
+    """Reads the binary CFG format (i.e., produced with `-cfg-format=binary`)."""
+
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+        self.strings = []
+        self.version = 0
+        self.order_key = None
+
+    def uleb128(self) -> int:
+        """Read a ULEB128-encoded integer."""
+        val = 0
+        shift = 0
+        while True:
+            byte = self.data[self.pos]
+            self.pos += 1
+            val |= (byte & 0x7f) << shift
+            shift += 7
+            if byte < 0x80:
+                return val
+
+    def string(self) -> str:
+        """Read a string (table index)."""
+        return self.strings[self.uleb128()]
+
+    def line(self) -> Optional[int]:
+        """Read a source line (zero if unknown)."""
+        return self.uleb128() or None
+
+    def records(self, *fields) -> List[dict]:
+        """Read a list of records, where each field is read by a method."""
+        return [{name: read() for name, read in fields}
+                for _ in range(self.uleb128())]
+
+    def function(self) -> dict:
+        """Read a function."""
+        kind = self.uleb128()
+        func_data = dict(name=self.string())
+
+        if kind == 0:
+            func_data['entry'] = self.string()
+            func_data['blocks'] = {
+                block.pop('label'): block for block in
+                self.records(('label', self.string),
+                             ('start_line', self.line),
+                             ('end_line', self.line))}
+            func_data['edges'] = self.records(('src', self.string),
+                                              ('dst', self.string),
+                                              ('type', self.string))
+            func_data['calls'] = self.records(('src', self.string),
+                                              ('dst', self.string),
+                                              ('type', self.string),
+                                              ('count', self.uleb128))
+            func_data['unresolved_calls'] = {
+                call['block']: call['count'] for call in
+                self.records(('block', self.string), ('count', self.uleb128))}
+            func_data['returns'] = self.records(('block', self.string),
+                                                ('type', self.string))
+        elif kind == 1:
+            # Whether each callee is external (since version 3)
+            fields = [('dst', self.string), ('type', self.string),
+                      ('count', self.uleb128)]
+            if self.version >= 3:
+                fields.append(('external', self.uleb128))
+            func_data['callees'] = self.records(*fields)
+            func_data['indirect_calls'] = self.uleb128()
+        elif kind == 2:
+            func_data['odr_ref'] = self.string()
+        else:
+            raise ValueError(f'Unknown function kind {kind}')
+
+        if self.order_key:
+            func_data[self.order_key] = self.uleb128()
+
+        return func_data
+
+    def module(self) -> dict:
+        """Read a module, from the current position."""
+        start = self.pos
+        if self.data[start:start + 4] != b'LCFG':
+            raise ValueError('Not a binary CFG')
+        version = int.from_bytes(self.data[start + 4:start + 8], 'little')
+        if version not in (1, 2, 3):
+            raise ValueError(f'Unsupported binary CFG version {version}')
+        self.version = version
+        self.pos = start + 8
+
+        self.strings = [None] * self.uleb128()
+        for i in range(len(self.strings)):
+            size = self.uleb128()
+            self.strings[i] = self.data[self.pos:self.pos + size].decode()
+            self.pos += size
+
+        module = self.string()
+
+        # The key that functions are ordered by (e.g., `scc`), if any (since
+        # version 2)
+        self.order_key = None
+        if version >= 2:
+            order_key = self.uleb128()
+            if order_key:
+                self.order_key = self.strings[order_key - 1]
+
+        functions = [self.function() for _ in range(self.uleb128())]
+        mod_data = dict(module=module, functions=functions)
+
+        # Collect the external callees of call graphs into the module's
+        # `external` list (as in the JSON format)
+        if version >= 3 and any('callees' in func_data
+                                for func_data in functions):
+            external = set()
+            for func_data in functions:
+                for callee in func_data.get('callees', []):
+                    if callee.pop('external'):
+                        external.add(callee['dst'])
+            mod_data['external'] = sorted(external)
+
+        return mod_data
+
+    def modules(self) -> List[dict]:
+        """
+        Read consecutive modules (e.g., as concatenated by the linker from each
+        object file's embedded CFG).
+        """
+        modules = []
+        while self.pos < len(self.data):
+            modules.append(self.module())
+        return modules
+
+
+def read_elf_section(path: Path, name: bytes) -> Optional[bytes]:
+    """
+    Read a section from an ELF file. The file is mapped, so only its headers
+    and the section itself are read. Returns `None` if the file is not an ELF
+    file or has no such section.
+    """
+    with path.open('rb') as inf:
+        if inf.read(4) != b'\x7fELF':
+            return None
+        elf = mmap.mmap(inf.fileno(), 0, access=mmap.ACCESS_READ)
+
+    with elf:
+        is_64 = elf[4] == 2
+        endian = '<' if elf[5] == 1 else '>'
+        if is_64:
+            shoff, = struct.unpack_from(endian + 'Q', elf, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH',
+                                                            elf, 0x3a)
+            shdr = endian + 'IIQQQQ'
+        else:
+            shoff, = struct.unpack_from(endian + 'I', elf, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH',
+                                                            elf, 0x2e)
+            shdr = endian + 'IIIIII'
+
+        # (name, type, flags, address, offset, size)
+        sections = [struct.unpack_from(shdr, elf, shoff + i * shentsize)
+                    for i in range(shnum)]
+        strtab = sections[shstrndx][4]
+        for sh_name, _, _, _, offset, size in sections:
+            start = strtab + sh_name
+            if elf[start:elf.find(b'\0', start)] == name:
+                return elf[offset:offset + size]
+
+    return None
+
+
+def load_cfgs(path: Path) -> List[dict]:
+    """
+    Load the module CFG(s) in a JSON or binary CFG file, or embedded in an ELF
+    file (i.e., with `-cfg-embed`).
+    """
+    if path.suffix == '.bin':
+        return [BinaryReader(path.read_bytes()).module()]
+
+    section = read_elf_section(path, EMBED_SECTION)
+    if section is not None:
+        return BinaryReader(section).modules()
+
+    with path.open() as inf:
+        return [expand_shapes(json.load(inf))]
+
+
 def count_edges(cfg: nx.DiGraph, edge_type: str) -> int:
     """Count edges of a particular type."""
     return sum(1 for _, _, data in cfg.edges(data='type') if data == edge_type)
@@ -75,17 +290,27 @@ def main():
 
     for cfg_path in args.cfg:
         logger.info('Parsing %s...', cfg_path)
-        with cfg_path.open() as inf:
-            mod_data = json.load(inf)
-
-        modules.append(mod_data)
+        modules.extend(load_cfgs(cfg_path))
 
     # Parse CFG(s)
     for mod_data in modules:
         module = mod_data['module']
+
+        # `-cfg-mode=callgraph` modules have no basic blocks to build the CFG
+        # from
+        if any('callees' in func_data for func_data in mod_data['functions']):
+            logger.error('Module %s only has a call graph (it was exported '
+                         'with `-cfg-mode=callgraph`). Skipping...', module)
+            continue
+
         for func_data in mod_data['functions']:
             func = func_data['name']
 
+            if 'odr_ref' in func_data:
+                logger.debug('Function %s (in %s) is emitted by another '
+                             'module. Skipping...', func, module)
+                continue
+
             if func in blacklist:
                 logger.info('Function %s (in %s) is blacklisted. '
                             'Skipping...', func, module)
@@ -140,7 +365,8 @@ def main():
                 src_bb = create_cfg_node(module, func, caller_bb)
                 dst_bb = create_cfg_node(callee_mod, callee_func,
                                          callee_data['entry'])
-                cfg.add_edge(src_bb, dst_bb, type=call['type'])
+                cfg.add_edge(src_bb, dst_bb, type=call['type'],
+                             count=call.get('count', 1))
 
                 # Add backward (return) edges
                 returns = callee_data['returns']
@@ -155,11 +381,13 @@ def main():
 
             # Count unresolved indirect calls and assign them to the CFG nodes
             # that make them
-            unresolved_call_count = Counter(func_data.get('unresolved_calls',
-                                                          []))
-            for bb in unresolved_call_count:
+            unresolved_call_count = func_data.get('unresolved_calls')
+            if unresolved_call_count is None:
+                unresolved_call_count = {}
+
+            for bb, count in unresolved_call_count.items():
                 node = create_cfg_node(module, func, bb)
-                cfg.nodes[node]['unresolved_calls'] = unresolved_call_count[bb]
+                cfg.nodes[node]['unresolved_calls'] = count
 
     if args.output:
         write_dot(cfg, args.output)
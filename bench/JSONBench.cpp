@@ -0,0 +1,434 @@
+//===-- JSONBench.cpp - Benchmark jsoncpp on CFG-shaped documents ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Measures the parse and serialize throughput, number of allocations and peak
+/// memory of the vendored jsoncpp on generated documents shaped like the
+/// pass's output: many small objects (blocks, edges and calls), large arrays
+/// and long, label-like keys. Appending to, and iterating over, arrays (as the
+/// pass's emitters and the readers of its output do) is measured separately.
+///
+/// Usage: jsoncpp-bench [-functions N] [-blocks N] [-repeat N]
+///
+//===----------------------------------------------------------------------===//
+
+#include "json/json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// Allocation counters. With glibc, malloc and friends are interposed to keep
+// them up to date (operator new allocates through malloc); elsewhere they
+// stay at zero
+static size_t NumAllocs = 0;
+static long long LiveBytes = 0;
+static long long PeakBytes = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t Size);
+void *__libc_calloc(size_t Num, size_t Size);
+void *__libc_realloc(void *Ptr, size_t Size);
+void __libc_free(void *Ptr);
+
+static void *noteAlloc(void *Ptr) {
+  if (Ptr) {
+    NumAllocs++;
+    LiveBytes += malloc_usable_size(Ptr);
+    PeakBytes = std::max(PeakBytes, LiveBytes);
+  }
+  return Ptr;
+}
+
+void *malloc(size_t Size) noexcept { return noteAlloc(__libc_malloc(Size)); }
+
+void *calloc(size_t Num, size_t Size) noexcept {
+  return noteAlloc(__libc_calloc(Num, Size));
+}
+
+void *realloc(void *Ptr, size_t Size) noexcept {
+  if (Ptr) {
+    LiveBytes -= malloc_usable_size(Ptr);
+  }
+  return noteAlloc(__libc_realloc(Ptr, Size));
+}
+
+void free(void *Ptr) noexcept {
+  if (Ptr) {
+    LiveBytes -= malloc_usable_size(Ptr);
+  }
+  __libc_free(Ptr);
+}
+}
+#endif
+
+namespace {
+
+struct Options {
+  unsigned Functions = 2000;
+  unsigned Blocks = 40;
+  unsigned Repeat = 5;
+};
+
+// Record keys are interned, as in the pass
+const Json::InternedKey StartLineKey("start_line");
+const Json::InternedKey EndLineKey("end_line");
+const Json::InternedKey SrcKey("src");
+const Json::InternedKey DstKey("dst");
+const Json::InternedKey TypeKey("type");
+const Json::InternedKey CountKey("count");
+const Json::InternedKey BlockKey("block");
+
+// Deterministic, so that runs are comparable
+class Generator {
+public:
+  Json::Value module(const Options &Opts);
+
+private:
+  std::string label();
+  std::string functionName();
+  Json::Value function(unsigned NumBlocks);
+
+  std::mt19937 Rng{42};
+  unsigned NextLabel = 0;
+};
+
+std::string Generator::label() {
+  static const char *const Prefixes[] = {
+      "entry",       "for.body",    "for.cond",   "for.inc",
+      "if.then",     "if.else",     "if.end",     "while.body",
+      "cleanup",     "invoke.cont", "lpad",       "sw.bb",
+      "for.body.lr.ph.i.i",         "_ZNSt6vectorIiSaIiEE9push_backERKi.exit"};
+  std::string Label = Prefixes[Rng() % (sizeof(Prefixes) / sizeof(*Prefixes))];
+  return Label + std::to_string(NextLabel++);
+}
+
+std::string Generator::functionName() {
+  static const char *const Names[] = {
+      "main", "_ZN4llvm12DenseMapBaseINS_8DenseMapIPKNS_5ValueEjEE",
+      "_ZNSt6vectorIiSaIiEE17_M_realloc_insertIJRKiEEEvN9__gnu_cxx17__"
+      "normal_iteratorIPiS1_EEDpOT_",
+      "parse_args", "_ZN5boost6detail17sp_counted_base7releaseEv"};
+  return std::string(Names[Rng() % (sizeof(Names) / sizeof(*Names))]) + "." +
+         std::to_string(Rng() % 100000);
+}
+
+Json::Value Generator::function(unsigned NumBlocks) {
+  Json::Value JFunc;
+  std::vector<std::string> Labels;
+  for (unsigned I = 0; I < NumBlocks; ++I) {
+    Labels.push_back(label());
+  }
+
+  JFunc["name"] = functionName();
+  JFunc["entry"] = Labels.front();
+
+  Json::Value &JBlocks = JFunc["blocks"];
+  for (const auto &Label : Labels) {
+    unsigned Line = Rng() % 5000;
+    Json::Value &JBlock = JBlocks[Label];
+    JBlock[StartLineKey] = Line;
+    JBlock[EndLineKey] = Line + Rng() % 10;
+  }
+
+  Json::Value &JEdges = JFunc["edges"];
+  for (unsigned I = 0; I < NumBlocks; ++I) {
+    for (unsigned Succ = 0, NumSuccs = 1 + Rng() % 2; Succ < NumSuccs;
+         ++Succ) {
+      Json::Value JEdge;
+      JEdge[SrcKey] = Labels[I];
+      JEdge[DstKey] = Labels[Rng() % NumBlocks];
+      JEdge[TypeKey] = "br";
+      JEdges.append(std::move(JEdge));
+    }
+  }
+
+  Json::Value &JCalls = JFunc["calls"];
+  for (unsigned I = 0; I < NumBlocks / 4; ++I) {
+    Json::Value JCall;
+    JCall[SrcKey] = Labels[Rng() % NumBlocks];
+    JCall[DstKey] = functionName();
+    JCall[TypeKey] = "call";
+    JCall[CountKey] = 1 + Rng() % 3;
+    JCalls.append(std::move(JCall));
+  }
+
+  Json::Value JRet;
+  JRet[BlockKey] = Labels.back();
+  JRet[TypeKey] = "ret";
+  JFunc["returns"].append(std::move(JRet));
+  JFunc["unresolved_calls"] = Json::Value::null;
+  return JFunc;
+}
+
+Json::Value Generator::module(const Options &Opts) {
+  Json::Value JMod;
+  JMod["module"] = "bench.bc";
+  Json::Value &JFuncs = JMod["functions"];
+  for (unsigned I = 0; I < Opts.Functions; ++I) {
+    // Mostly small functions, with the occasional large one
+    unsigned NumBlocks = 1 + Rng() % (I % 10 ? Opts.Blocks : 10 * Opts.Blocks);
+    JFuncs.append(function(NumBlocks));
+  }
+  return JMod;
+}
+
+struct Result {
+  double Seconds;
+  size_t Allocs;
+  long long PeakBytes;
+};
+
+// Run Fn Repeat times, and keep the fastest run
+Result measure(unsigned Repeat, const std::function<void()> &Fn) {
+  Result Best = {1e300, 0, 0};
+  for (unsigned I = 0; I < Repeat; ++I) {
+    size_t AllocsBefore = NumAllocs;
+    long long LiveBefore = LiveBytes;
+    PeakBytes = LiveBytes;
+
+    auto Start = std::chrono::steady_clock::now();
+    Fn();
+    std::chrono::duration<double> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+
+    if (Elapsed.count() < Best.Seconds) {
+      Best = {Elapsed.count(), NumAllocs - AllocsBefore,
+              PeakBytes - LiveBefore};
+    }
+  }
+  return Best;
+}
+
+void report(const char *Name, size_t Bytes, const Result &R) {
+  std::printf("%-36s %9.1f %12zu %10.1f\n", Name,
+              static_cast<double>(Bytes) / R.Seconds / 1e6, R.Allocs,
+              static_cast<double>(R.PeakBytes) / 1e6);
+}
+
+void benchParse(const char *Name, const std::string &Doc, unsigned Repeat,
+                const Json::CharReaderBuilder &Builder, bool InArena = false) {
+  std::unique_ptr<Json::CharReader> Reader(Builder.newCharReader());
+  Result R = measure(Repeat, [&]() {
+    Json::Arena Arena;
+    std::unique_ptr<Json::Arena::Scope> Scope;
+    if (InArena) {
+      Scope.reset(new Json::Arena::Scope(Arena));
+    }
+    Json::Value Root;
+    Json::String Errs;
+    if (!Reader->parse(Doc.data(), Doc.data() + Doc.size(), &Root, &Errs)) {
+      std::fprintf(stderr, "%s: %s", Name, Errs.c_str());
+      std::exit(1);
+    }
+  });
+  report(Name, Doc.size(), R);
+}
+
+void benchWrite(const char *Name, unsigned Repeat,
+                const std::function<size_t()> &Fn) {
+  size_t Bytes = 0;
+  Result R = measure(Repeat, [&]() { Bytes = Fn(); });
+  report(Name, Bytes, R);
+}
+
+// Array operations are reported in millions of elements per second
+void benchArray(const char *Name, unsigned Repeat, size_t Elements,
+                const std::function<void()> &Fn) {
+  Result R = measure(Repeat, Fn);
+  std::printf("%-36s %9.1f %12zu %10.1f\n", Name,
+              static_cast<double>(Elements) / R.Seconds / 1e6, R.Allocs,
+              static_cast<double>(R.PeakBytes) / 1e6);
+}
+
+// An array of Elements edge-like objects
+Json::Value edgeArray(size_t Elements) {
+  Json::Value Edges(Json::arrayValue);
+  for (size_t I = 0; I < Elements; ++I) {
+    Json::Value Edge;
+    Edge["src"] = Json::UInt64(I);
+    Edge["dst"] = Json::UInt64(I + 1);
+    Edges.append(std::move(Edge));
+  }
+  return Edges;
+}
+
+// Keeps the results of iteration from being optimized away
+volatile uint64_t Sink;
+
+// Appends to a string, like writing to a buffered file would
+class StringSink : public Json::CompactWriter::Sink {
+public:
+  void write(char const *Data, size_t Size) override { Out.append(Data, Size); }
+
+  std::string Out;
+};
+
+bool parseOptions(int Argc, char **Argv, Options &Opts) {
+  for (int I = 1; I < Argc; ++I) {
+    unsigned *Opt = nullptr;
+    if (!std::strcmp(Argv[I], "-functions")) {
+      Opt = &Opts.Functions;
+    } else if (!std::strcmp(Argv[I], "-blocks")) {
+      Opt = &Opts.Blocks;
+    } else if (!std::strcmp(Argv[I], "-repeat")) {
+      Opt = &Opts.Repeat;
+    }
+
+    if (!Opt || I + 1 == Argc || std::atoi(Argv[I + 1]) <= 0) {
+      return false;
+    }
+    *Opt = static_cast<unsigned>(std::atoi(Argv[++I]));
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+int main(int Argc, char **Argv) {
+  Options Opts;
+  if (!parseOptions(Argc, Argv, Opts)) {
+    std::fprintf(stderr,
+                 "usage: %s [-functions N] [-blocks N] [-repeat N]\n",
+                 Argv[0]);
+    return 1;
+  }
+
+  const Json::Value JMod = Generator().module(Opts);
+
+  Json::StreamWriterBuilder CompactBuilder;
+  CompactBuilder["indentation"] = "";
+  const std::string Styled = JMod.toStyledString();
+  const std::string Compact = Json::writeString(CompactBuilder, JMod);
+
+  std::printf("%u functions, %.1f MB styled, %.1f MB compact, best of %u "
+              "runs\n\n",
+              Opts.Functions, static_cast<double>(Styled.size()) / 1e6,
+              static_cast<double>(Compact.size()) / 1e6, Opts.Repeat);
+#if !defined(__GLIBC__)
+  std::printf("(allocations are only counted with glibc)\n\n");
+#endif
+  std::printf("%-36s %9s %12s %10s\n", "benchmark", "MB/s", "allocations",
+              "peak MB");
+
+  // Parse
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+  Result R = measure(Opts.Repeat, [&]() {
+    Json::Reader Reader;
+    Json::Value Root;
+    if (!Reader.parse(Styled, Root, false)) {
+      std::fprintf(stderr, "Reader: %s",
+                   Reader.getFormattedErrorMessages().c_str());
+      std::exit(1);
+    }
+  });
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+  report("Reader (styled)", Styled.size(), R);
+
+  Json::CharReaderBuilder Builder;
+  Builder["collectComments"] = false;
+  benchParse("CharReaderBuilder (styled)", Styled, Opts.Repeat, Builder);
+  benchParse("CharReaderBuilder (compact)", Compact, Opts.Repeat, Builder);
+  benchParse("  arena (compact)", Compact, Opts.Repeat, Builder,
+             /* InArena */ true);
+  Builder["structuralIndex"] = true;
+  benchParse("  structuralIndex (compact)", Compact, Opts.Repeat, Builder);
+  Builder["inSitu"] = true;
+  benchParse("  structuralIndex, inSitu (compact)", Compact, Opts.Repeat,
+             Builder);
+  Builder["structuralIndex"] = false;
+  benchParse("  inSitu (compact)", Compact, Opts.Repeat, Builder);
+  Builder["structuralIndex"] = true;
+  benchParse("  structuralIndex, inSitu, arena", Compact, Opts.Repeat,
+             Builder, /* InArena */ true);
+
+  // Build (by copying) and destroy a tree, as the pass does
+  std::printf("\n");
+  benchWrite("Value copy", Opts.Repeat, [&]() {
+    Json::Value Copy(JMod);
+    return Compact.size();
+  });
+  benchWrite("Value copy (arena)", Opts.Repeat, [&]() {
+    Json::Arena Arena;
+    Json::Arena::Scope Scope(Arena);
+    Json::Value Copy(JMod);
+    return Compact.size();
+  });
+
+  // Append to, and iterate over, arrays
+  const size_t Elements = size_t(Opts.Functions) * Opts.Blocks * 10;
+  std::printf("\n%-36s %9s %12s %10s\n", "arrays", "M elem/s", "allocations",
+              "peak MB");
+  benchArray("append (int)", Opts.Repeat, Elements, [&]() {
+    Json::Value Array(Json::arrayValue);
+    for (size_t I = 0; I < Elements; ++I) {
+      Array.append(Json::UInt64(I));
+    }
+  });
+  benchArray("append (object)", Opts.Repeat, Elements,
+             [&]() { edgeArray(Elements); });
+  benchArray("append (object, arena)", Opts.Repeat, Elements, [&]() {
+    Json::Arena Arena;
+    Json::Arena::Scope Scope(Arena);
+    edgeArray(Elements);
+  });
+
+  const Json::Value Edges = edgeArray(Elements);
+  benchArray("iterate (index)", Opts.Repeat, Elements, [&]() {
+    uint64_t Sum = 0;
+    for (Json::ArrayIndex I = 0, N = Edges.size(); I < N; ++I) {
+      Sum += Edges[I]["dst"].asUInt64();
+    }
+    Sink = Sum;
+  });
+  benchArray("iterate (iterator)", Opts.Repeat, Elements, [&]() {
+    uint64_t Sum = 0;
+    for (const auto &Edge : Edges) {
+      Sum += Edge["dst"].asUInt64();
+    }
+    Sink = Sum;
+  });
+
+  // Serialize
+  std::printf("\n");
+  Json::StreamWriterBuilder StyledBuilder;
+  benchWrite("StreamWriterBuilder (styled)", Opts.Repeat,
+             [&]() { return Json::writeString(StyledBuilder, JMod).size(); });
+  benchWrite("StreamWriterBuilder (compact)", Opts.Repeat,
+             [&]() { return Json::writeString(CompactBuilder, JMod).size(); });
+  benchWrite("toStyledString", Opts.Repeat,
+             [&]() { return JMod.toStyledString().size(); });
+  benchWrite("CompactWriter", Opts.Repeat, [&]() {
+    StringSink Sink;
+    {
+      Json::CompactWriter Writer(Sink);
+      Writer.write(JMod);
+    }
+    return Sink.Out.size();
+  });
+
+  return 0;
+}
@@ -93,11 +93,11 @@ license you like.
 // 3. /CMakeLists.txt
 // IMPORTANT: also update the SOVERSION!!
 
-#define JSONCPP_VERSION_STRING "1.9.2"
+#define JSONCPP_VERSION_STRING "1.10.0-cfg"
 #define JSONCPP_VERSION_MAJOR 1
-#define JSONCPP_VERSION_MINOR 9
-#define JSONCPP_VERSION_PATCH 2
-#define JSONCPP_VERSION_QUALIFIER
+#define JSONCPP_VERSION_MINOR 10
+#define JSONCPP_VERSION_PATCH 0
+#define JSONCPP_VERSION_QUALIFIER -cfg
 #define JSONCPP_VERSION_HEXA                                                   \
   ((JSONCPP_VERSION_MAJOR << 24) | (JSONCPP_VERSION_MINOR << 16) |             \
    (JSONCPP_VERSION_PATCH << 8))
@@ -549,6 +549,7 @@ public:
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <array>
 #include <exception>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <vector>
@@ -677,6 +678,155 @@ private:
   const char* c_str_;
 };
 
+/** \brief Lightweight wrapper to tag characters that a Value may refer to
+ * without copying them (e.g., a document being parsed in-situ).
+ *
+ * Unlike StaticString, the characters need not be null-terminated, but they
+ * must outlive the Value (and any Value it is moved to). Copies of the Value
+ * own a copy of the characters.
+ *
+ * Example of usage:
+ * \code
+ * Json::Value aValue(BorrowedString(begin, end));
+ * Json::Value object;
+ * object[BorrowedString(keyBegin, keyEnd)] = 1234;
+ * \endcode
+ */
+class JSON_API BorrowedString {
+public:
+  BorrowedString(const char* begin, const char* end)
+      : begin_(begin), end_(end) {}
+
+  const char* begin() const { return begin_; }
+  const char* end() const { return end_; }
+
+private:
+  const char* begin_;
+  const char* end_;
+};
+
+/** \brief An object key that is stored once, and shared by every object it
+ * is inserted into.
+ *
+ * Keys are interned in a global table, so inserting one allocates nothing,
+ * and writers output it without looking for characters to escape. Interned
+ * keys are never released: only intern the fixed keys that are repeated over
+ * and over in a document, not keys read from input.
+ *
+ * Example of usage:
+ * \code
+ * static const Json::InternedKey src("src");
+ * Json::Value edge;
+ * edge[src] = "entry";
+ * \endcode
+ */
+class JSON_API InternedKey {
+public:
+  explicit InternedKey(const char* key);
+  InternedKey(const char* begin, const char* end);
+
+  /// The interned characters, null-terminated.
+  const char* data() const { return data_; }
+  unsigned length() const { return length_; }
+
+private:
+  friend class Value;
+
+  const char* data_;
+  unsigned length_;
+  // Written as is, between quotes
+  bool plain_;
+};
+
+/** \brief Memory for Value trees that is released all at once.
+ *
+ * While an Arena::Scope is active on a thread, the strings, object members
+ * and array elements of the Values created on that thread are allocated in
+ * its arena. Their destructors then free nothing: the memory is released
+ * when the arena is destroyed, which must be after every Value that uses it.
+ * Containers keep allocating in the arena they were created in, even after
+ * the scope ends. An arena must only be used by one thread at a time.
+ *
+ * Example of usage:
+ * \code
+ * Json::Arena arena;
+ * {
+ *   Json::Arena::Scope scope(arena);
+ *   Json::Value root;
+ *   reader->parse(begin, end, &root, &errs);
+ *   ...
+ * }
+ * \endcode
+ */
+class JSON_API Arena {
+public:
+  /// Makes an arena current on this thread, until destroyed.
+  class JSON_API Scope {
+  public:
+    explicit Scope(Arena& arena);
+    ~Scope();
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+  private:
+    Arena* previous_;
+  };
+
+  explicit Arena(size_t blockSize = 1 << 16);
+  ~Arena();
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  /// The arena of the innermost scope on this thread, or null.
+  static Arena* current();
+
+private:
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* next_;
+  char* end_;
+  size_t blockSize_;
+};
+
+/** \brief Allocates in the arena that was current when it was created, or on
+ * the heap if there was none. Copies of a container allocate in the arena
+ * that is current when they are made.
+ */
+template <typename T> class ArenaAllocator {
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator() : arena_(Arena::current()) {}
+  template <typename U>
+  ArenaAllocator(ArenaAllocator<U> const& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (!arena_)
+      return std::allocator<T>().allocate(n);
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    if (!arena_)
+      std::allocator<T>().deallocate(p, n);
+  }
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+
+  Arena* arena() const { return arena_; }
+  bool operator==(ArenaAllocator const& other) const {
+    return arena_ == other.arena_;
+  }
+  bool operator!=(ArenaAllocator const& other) const {
+    return arena_ != other.arena_;
+  }
+
+private:
+  Arena* arena_;
+};
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -780,14 +930,20 @@ private:
 #ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
   class CZString {
   public:
-    enum DuplicationPolicy { noDuplication = 0, duplicate, duplicateOnCopy };
+    enum DuplicationPolicy {
+      noDuplication = 0,
+      duplicate,
+      duplicateOnCopy,
+      duplicateInArena, // like duplicate, but released with the arena
+      interned          // an InternedKey that needs no escaping
+    };
     CZString(ArrayIndex index);
     CZString(char const* str, unsigned length, DuplicationPolicy allocate);
     CZString(CZString const& other);
-    CZString(CZString&& other);
+    CZString(CZString&& other) JSONCPP_NOEXCEPT;
     ~CZString();
     CZString& operator=(const CZString& other);
-    CZString& operator=(CZString&& other);
+    CZString& operator=(CZString&& other) JSONCPP_NOEXCEPT;
 
     bool operator<(CZString const& other) const;
     bool operator==(CZString const& other) const;
@@ -796,13 +952,14 @@ private:
     char const* data() const;
     unsigned length() const;
     bool isStaticString() const;
+    bool isInterned() const;
 
   private:
     void swap(CZString& other);
 
     struct StringStorage {
-      unsigned policy_ : 2;
-      unsigned length_ : 30; // 1GB max
+      unsigned policy_ : 3;
+      unsigned length_ : 29; // 512MB max
     };
 
     char const* cstr_; // actually, a prefixed string, unless policy is noDup
@@ -813,11 +970,133 @@ private:
   };
 
 public:
-#ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
-#else
-  typedef CppTL::SmallMap<CZString, Value> ObjectValues;
-#endif // ifndef JSON_USE_CPPTL_SMALLMAP
+  /** \brief Members of an object, in insertion order.
+   *
+   * Members are stored in chunks that are never reallocated: the first holds
+   * firstChunkSize members, and each later one as many as all chunks before
+   * it. Adding a member thus never moves the others, and neither does
+   * removing one, which only marks its slot as erased. Small objects are
+   * searched linearly; once an object grows past maxLinearSize members, a
+   * hash index of its keys is kept as well.
+   */
+  class ObjectValues {
+  public:
+    typedef std::pair<CZString, Value> value_type;
+
+    /// Bidirectional iterator over the members, in insertion order.
+    template <typename T> class Iterator {
+    public:
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef T* pointer;
+      typedef T& reference;
+      typedef typename std::conditional<std::is_const<T>::value,
+                                        ObjectValues const,
+                                        ObjectValues>::type Owner;
+
+      Iterator() = default;
+      Iterator(Owner* owner, size_t pos) : owner_(owner), pos_(pos) {
+        if (owner && pos < owner->slots_) {
+          ObjectValues::value_type* chunkEnd;
+          member_ = owner->locate(pos, &chunkEnd);
+          chunkEnd_ = chunkEnd;
+        }
+      }
+      /// Iterators convert to const_iterator.
+      template <typename U>
+      Iterator(Iterator<U> const& other)
+          : owner_(other.owner_), pos_(other.pos_), member_(other.member_),
+            chunkEnd_(other.chunkEnd_) {}
+
+      reference operator*() const { return *member_; }
+      pointer operator->() const { return member_; }
+      Iterator& operator++() {
+        // Members are contiguous within a chunk
+        ++pos_;
+        if (++member_ == chunkEnd_ || owner_->erased_)
+          *this = Iterator(owner_, owner_->nextLive(pos_ - 1));
+        return *this;
+      }
+      Iterator& operator--() {
+        *this = Iterator(owner_, owner_->previousLive(pos_));
+        return *this;
+      }
+      difference_type operator-(Iterator const& other) const {
+        return owner_->distance(other.pos_, pos_);
+      }
+      bool operator==(Iterator const& other) const {
+        return pos_ == other.pos_;
+      }
+      bool operator!=(Iterator const& other) const {
+        return pos_ != other.pos_;
+      }
+
+    private:
+      template <typename U> friend class Iterator;
+
+      Owner* owner_ = nullptr;
+      size_t pos_ = 0;
+      T* member_ = nullptr;
+      T* chunkEnd_ = nullptr;
+    };
+    typedef Iterator<value_type> iterator;
+    typedef Iterator<value_type const> const_iterator;
+
+    ObjectValues() = default;
+    ObjectValues(const ObjectValues& other);
+    ObjectValues& operator=(const ObjectValues& other) = delete;
+    ~ObjectValues();
+
+    iterator begin() { return iterator(this, firstLive()); }
+    iterator end() { return iterator(this, slots_); }
+    const_iterator begin() const { return const_iterator(this, firstLive()); }
+    const_iterator end() const { return const_iterator(this, slots_); }
+    size_t size() const { return slots_ - erased_; }
+    bool empty() const { return size() == 0; }
+
+    void clear();
+    iterator find(const CZString& key);
+    const_iterator find(const CZString& key) const;
+    /// Add a member at the end. \pre key is not already a member.
+    Value& insert(CZString key, Value&& value);
+    void erase(iterator it);
+
+    /// Members are compared in key order, regardless of insertion order.
+    bool operator==(const ObjectValues& other) const;
+    bool operator<(const ObjectValues& other) const;
+
+  private:
+    // Most objects are small records (e.g., edges with src, dst and type)
+    static const size_t firstChunkSize = 3;
+    static const size_t maxLinearSize = 16;
+
+    size_t numChunks() const;
+    value_type* locate(size_t pos, value_type** chunkEnd) const;
+    value_type& slot(size_t pos);
+    value_type const& slot(size_t pos) const;
+    value_type* appendSlot();
+    size_t firstLive() const;
+    size_t nextLive(size_t pos) const;
+    size_t previousLive(size_t pos) const;
+    std::ptrdiff_t distance(size_t from, size_t to) const;
+
+    size_t position(const CZString& key) const;
+    void addToIndex(size_t pos);
+    void rebuildIndex();
+
+    // The first chunk, and the later ones. Chunks are allocated like index_
+    value_type* first_ = nullptr;
+    value_type** chunks_ = nullptr;
+    // Slots in use, including those of erased members
+    ArrayIndex slots_ = 0;
+    ArrayIndex erased_ = 0;
+    // Open-addressing hash table of member positions + 1 (0 if empty slot).
+    // Only used once the object is larger than maxLinearSize.
+    std::vector<ArrayIndex, ArenaAllocator<ArrayIndex>> index_;
+  };
+
+  typedef std::vector<Value, ArenaAllocator<Value>> ArrayValues;
 #endif // ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
 
 public:
@@ -865,19 +1144,21 @@ public:
    *   \endcode
    */
   Value(const StaticString& value);
+  /// Refers to the string without copying it. \see BorrowedString
+  Value(const BorrowedString& value);
   Value(const String& value);
 #ifdef JSON_USE_CPPTL
   Value(const CppTL::ConstString& value);
 #endif
   Value(bool value);
   Value(const Value& other);
-  Value(Value&& other);
+  Value(Value&& other) JSONCPP_NOEXCEPT;
   ~Value();
 
   /// \note Overwrite existing comments. To preserve comments, use
   /// #swapPayload().
   Value& operator=(const Value& other);
-  Value& operator=(Value&& other);
+  Value& operator=(Value&& other) JSONCPP_NOEXCEPT;
 
   /// Swap everything.
   void swap(Value& other);
@@ -900,7 +1181,9 @@ public:
   bool operator!=(const Value& other) const;
   int compare(const Value& other) const;
 
-  const char* asCString() const; ///< Embedded zeroes could cause you trouble!
+  /// Embedded zeroes could cause you trouble! \pre The string is not
+  /// borrowed (see BorrowedString), as it may not be null-terminated.
+  const char* asCString() const;
 #if JSONCPP_USING_SECURE_MEMORY
   unsigned getCStringLength() const; // Allows you to understand the length of
                                      // the CString
@@ -988,6 +1271,8 @@ public:
   /// \brief Append value to array at the end.
   ///
   /// Equivalent to jsonvalue[jsonvalue.size()] = value;
+  /// \note Array elements are stored contiguously, so (like std::vector)
+  /// growing an array invalidates references to its elements.
   Value& append(const Value& value);
   Value& append(Value&& value);
 
@@ -1018,6 +1303,14 @@ public:
    *   \endcode
    */
   Value& operator[](const StaticString& key);
+  /// Access an object value by name, create a null member if it does not
+  /// exist. A new member's name refers to the key without copying it.
+  /// \see BorrowedString
+  Value& operator[](const BorrowedString& key);
+  /// Access an object value by name, create a null member if it does not
+  /// exist. A new member's name shares the key's interned characters.
+  /// \see InternedKey
+  Value& operator[](const InternedKey& key);
 #ifdef JSON_USE_CPPTL
   /// Access an object value by name, create a null member if it does not exist.
   Value& operator[](const CppTL::ConstString& key);
@@ -1092,7 +1385,7 @@ public:
   bool isMember(const CppTL::ConstString& key) const;
 #endif
 
-  /// \brief Return a list of the member names.
+  /// \brief Return a list of the member names, sorted by name.
   ///
   /// If null, return an empty list.
   /// \pre type() is objectValue or nullValue
@@ -1121,6 +1414,8 @@ public:
 
   String toStyledString() const;
 
+  /// \note Object members are visited in insertion order (in key order
+  /// before jsoncpp 1.10.0-cfg); getMemberNames() and the writers sort them.
   const_iterator begin() const;
   const_iterator end() const;
 
@@ -1140,8 +1435,12 @@ private:
   }
   bool isAllocated() const { return bits_.allocated_; }
   void setIsAllocated(bool v) { bits_.allocated_ = v; }
+  // The string's characters and length, however they are stored
+  void stringData(unsigned* length, char const** value) const;
 
   void initBasic(ValueType type, bool allocated = false);
+  // Set string_ to an owned copy of the characters
+  void dupString(char const* value, unsigned length);
   void dupPayload(const Value& other);
   void releasePayload();
   void dupMeta(const Value& other);
@@ -1165,13 +1464,20 @@ private:
     bool bool_;
     char* string_; // if allocated_, ptr to { unsigned, char[] }.
     ObjectValues* map_;
+    ArrayValues* array_;
   } value_;
 
   struct {
     // Really a ValueType, but types should agree for bitfield packing.
     unsigned int value_type_ : 8;
-    // Unless allocated_, string_ must be null-terminated.
+    // Unless allocated_ or borrowed_, string_ must be null-terminated.
     unsigned int allocated_ : 1;
+    // string_ is not owned, and is borrowedLength_ characters long.
+    unsigned int borrowed_ : 1;
+    // string_, map_ or array_ was allocated in an Arena.
+    unsigned int arena_ : 1;
+    // Fits in what would otherwise be padding
+    unsigned int borrowedLength_;
   } bits_;
 
   class Comments {
@@ -1296,6 +1602,9 @@ public:
   /// objectValue.
   /// \note Better version than memberName(). Allows embedded nulls.
   char const* memberName(char const** end) const;
+  /// Whether the member name is an InternedKey that can be written without
+  /// escaping.
+  bool isPlainInternedName() const;
 
 protected:
   Value& deref() const;
@@ -1312,14 +1621,20 @@ protected:
 
 private:
   Value::ObjectValues::iterator current_;
+  // Current and first element, if iterating over an arrayValue.
+  Value* element_{nullptr};
+  Value* first_{nullptr};
   // Indicates that iterator is for a null value.
   bool isNull_{true};
+  // Indicates that iterator is for an arrayValue.
+  bool isArray_{false};
 
 public:
   // For some reason, BORLAND needs these at the end, rather
   // than earlier. No idea why.
   ValueIteratorBase();
   explicit ValueIteratorBase(const Value::ObjectValues::iterator& current);
+  ValueIteratorBase(Value* element, Value* first);
 };
 
 /** \brief const iterator for object and array value.
@@ -1343,6 +1658,7 @@ private:
   /*! \internal Use by Value to create an iterator.
    */
   explicit ValueConstIterator(const Value::ObjectValues::iterator& current);
+  ValueConstIterator(Value* element, Value* first);
 
 public:
   SelfType& operator=(const ValueIteratorBase& other);
@@ -1395,6 +1711,7 @@ private:
   /*! \internal Use by Value to create an iterator.
    */
   explicit ValueIterator(const Value::ObjectValues::iterator& current);
+  ValueIterator(Value* element, Value* first);
 
 public:
   SelfType& operator=(const SelfType& other);
@@ -1778,6 +2095,19 @@ public:
    * - `"allowSpecialFloats": false or true`
    *   - If true, special float values (NaNs and infinities) are allowed and
    *     their values are lossfree restorable.
+   * - `"structuralIndex": false or true`
+   *   - If true, parse with a two-stage reader that first indexes the
+   *     document's structural characters (with SIMD where available), which
+   *     is considerably faster for large documents. Only strict JSON is
+   *     accepted, whatever the settings above; "stackLimit", "failIfExtra",
+   *     "rejectDupKeys" and "strictRoot" are honoured.
+   * - `"inSitu": false or true`
+   *   - If true, strings and member names refer to the document instead of
+   *     being copied (see BorrowedString). Strings with escapes are decoded
+   *     into an arena owned by the CharReader. Both the document and the
+   *     CharReader must outlive the Value, and the CharReader must not parse
+   *     another document while the Value is in use. Copying the Value (or any
+   *     of its members) copies its strings.
    *
    * You can examine 'settings_` yourself to see the defaults. You can also
    * write and read them just like any JSON Value.
@@ -1848,6 +2178,103 @@ bool JSON_API parseFromStream(CharReader::Factory const&,
  */
 JSON_API IStream& operator>>(IStream&, Value&);
 
+/** \brief A value of a document that is only read on demand.
+ *
+ * Visiting a LazyValue's members or elements skips the subtrees that are not
+ * visited by matching their brackets (outside of strings), without building
+ * Values for them. Only the subtrees passed to parse() are fully read, so
+ * picking a few values out of a large document is cheap.
+ *
+ * The document must outlive its LazyValues. Navigation assumes strict JSON;
+ * it throws RuntimeError if it finds anything else, but skipped subtrees are
+ * not validated.
+ *
+ * Usage:
+ *   \code
+ *   Json::LazyValue root(begin, end);
+ *   Json::LazyValue functions;
+ *   if (root.find("functions", &functions)) {
+ *     for (Json::LazyValue function : functions) {
+ *       Json::LazyValue name;
+ *       if (function.find("name", &name) && name.asString() == "main") {
+ *         Json::CharReaderBuilder builder;
+ *         Json::Value value;
+ *         function.parse(builder, &value, nullptr);
+ *       }
+ *     }
+ *   }
+ *   \endcode
+ */
+class JSON_API LazyValue {
+public:
+  class JSON_API const_iterator {
+  public:
+    const_iterator() = default;
+
+    /// The element, or the member's value.
+    LazyValue operator*() const;
+    /// The member's name. \pre The iterator is over an object.
+    String name() const;
+
+    const_iterator& operator++();
+    bool operator==(const_iterator const& other) const {
+      return current_ == other.current_;
+    }
+    bool operator!=(const_iterator const& other) const {
+      return current_ != other.current_;
+    }
+
+  private:
+    friend class LazyValue;
+    const_iterator(char const* current, char const* endDoc, bool isObject);
+    void read();
+    bool hasName(String const& name) const;
+
+    // The element or member name, or nullptr past the last one
+    char const* current_{nullptr};
+    char const* value_{nullptr};
+    char const* endDoc_{nullptr};
+    bool isObject_{false};
+  };
+
+  LazyValue() = default;
+  /// The document's root. \pre The document is not empty.
+  LazyValue(char const* beginDoc, char const* endDoc);
+
+  bool isNull() const;
+  bool isBool() const;
+  bool isNumeric() const;
+  bool isString() const;
+  bool isArray() const;
+  bool isObject() const;
+
+  /// Iterate over the elements of an array, or the members of an object.
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  /// Find the value of the member named key.
+  /// \return true if there is one. \pre The value is an object.
+  bool find(String const& key, LazyValue* member) const;
+
+  /// The decoded string. \pre The value is a string.
+  String asString() const;
+
+  /** Fully read the value.
+   * Offsets and error locations are relative to the start of the value.
+   * \see CharReader::parse()
+   */
+  bool parse(CharReader::Factory const& factory,
+             Value* root,
+             String* errs) const;
+
+  /// The end of the value's text (skipping it, if it is a container).
+  char const* skip() const;
+
+private:
+  char const* begin_{nullptr}; // First character of the value
+  char const* endDoc_{nullptr};
+};
+
 } // namespace Json
 
 #pragma pack(pop)
@@ -2015,6 +2442,52 @@ public:
   static void setDefaults(Json::Value* settings);
 };
 
+/** \brief Writes a Value without any whitespace, for high throughput.
+ *
+ * The JSON text is built in a reusable buffer, and handed to a Sink each time
+ * the buffer fills up, so the document is never materialized as a whole.
+ * Object members are written in key order, and real values with 17
+ * significant digits (as with the StreamWriterBuilder defaults). Comments are
+ * dropped.
+ *
+ * Usage:
+ *   \code
+ *   struct StdoutSink : Json::CompactWriter::Sink {
+ *     void write(char const* data, size_t length) override {
+ *       fwrite(data, 1, length, stdout);
+ *     }
+ *   } sink;
+ *   Json::CompactWriter writer(sink);
+ *   writer.write(value);
+ *   writer.flush();
+ *   \endcode
+ */
+class JSON_API CompactWriter {
+public:
+  /// Receives the written text, in order, one chunk at a time.
+  class JSON_API Sink {
+  public:
+    virtual ~Sink();
+    virtual void write(char const* data, size_t length) = 0;
+  };
+
+  explicit CompactWriter(Sink& sink, size_t bufferSize = 1 << 16);
+  /// Flushes any buffered text.
+  ~CompactWriter();
+
+  /// Write root, followed by a newline.
+  void write(Value const& root);
+  /// Hand all buffered text to the sink.
+  void flush();
+
+private:
+  void writeValue(Value const& value);
+
+  Sink& sink_;
+  size_t bufferSize_;
+  String buffer_;
+};
+
 /** \brief Abstract class for writers.
  * \deprecated Use StreamWriter. (And really, this is an implementation detail.)
  */
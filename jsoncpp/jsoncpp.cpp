@@ -105,6 +105,24 @@ license you like.
 #include <clocale>
 #endif
 
+#include <cstdint>
+
+// SSE2 is part of x86-64, so it is always available there. Defining
+// JSONCPP_NO_SIMD selects the scalar code paths instead (e.g., to test them)
+#if !defined(JSONCPP_NO_SIMD) &&                                               \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSONCPP_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#if !defined(JSONCPP_NO_SIMD) && defined(__AVX2__)
+#define JSONCPP_HAS_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 /* This header provides common string manipulation support, such as UTF-8,
  * portable conversion from/to string...
  *
@@ -121,6 +139,47 @@ static inline char getDecimalPoint() {
 #endif
 }
 
+/// Returns the index of the lowest set bit of x, which must not be zero.
+static inline unsigned countTrailingZeros(unsigned x) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+}
+
+static inline unsigned countTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+  unsigned low = static_cast<unsigned>(x);
+  return low ? countTrailingZeros(low)
+             : 32 + countTrailingZeros(static_cast<unsigned>(x >> 32));
+#else
+  return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+}
+
+/// Returns the index of the highest set bit of x, which must not be zero.
+static inline unsigned floorLog2(size_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse(&index, static_cast<unsigned long>(x));
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(sizeof(unsigned long long) * 8 - 1 -
+                               __builtin_clzll(x));
+#endif
+}
+
 /// Converts a unicode code-point to UTF-8.
 static inline String codePointToUTF8(unsigned int cp) {
   String result;
@@ -165,11 +224,31 @@ typedef char UIntToStringBuffer[uintToStringBufferSize];
  *        Must have at least uintToStringBufferSize chars free.
  */
 static inline void uintToString(LargestUInt value, char*& current) {
+  // Two digits at a time, to halve the number of divisions
+  static const char digits2[] = "00010203040506070809"
+                                "10111213141516171819"
+                                "20212223242526272829"
+                                "30313233343536373839"
+                                "40414243444546474849"
+                                "50515253545556575859"
+                                "60616263646566676869"
+                                "70717273747576777879"
+                                "80818283848586878889"
+                                "90919293949596979899";
   *--current = 0;
-  do {
-    *--current = static_cast<char>(value % 10U + static_cast<unsigned>('0'));
-    value /= 10;
-  } while (value != 0);
+  while (value >= 100) {
+    auto const i = static_cast<unsigned>(value % 100U) * 2;
+    value /= 100;
+    *--current = digits2[i + 1];
+    *--current = digits2[i];
+  }
+  if (value >= 10) {
+    auto const i = static_cast<unsigned>(value) * 2;
+    *--current = digits2[i + 1];
+    *--current = digits2[i];
+  } else {
+    *--current = static_cast<char>(value + static_cast<unsigned>('0'));
+  }
 }
 
 /** Change ',' to '.' everywhere in buffer.
@@ -1113,11 +1192,51 @@ public:
   bool failIfExtra_;
   bool rejectDupKeys_;
   bool allowSpecialFloats_;
+  bool inSitu_;
   size_t stackLimit_;
 }; // OurFeatures
 
 OurFeatures OurFeatures::all() { return {}; }
 
+// Holds the decoded strings of a document read in-situ. Strings are never
+// moved, so that Values can borrow them until the arena is cleared.
+class StringArena {
+public:
+  char const* store(char const* begin, char const* end);
+  void clear() {
+    blocks_.clear();
+    used_ = 0;
+  }
+
+private:
+  static size_t const blockSize = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  size_t used_{0}; // Characters used in the last block
+};
+
+char const* StringArena::store(char const* begin, char const* end) {
+  auto const length = static_cast<size_t>(end - begin);
+  if (length > blockSize / 4) {
+    // Give large strings a block of their own, so that the last block keeps
+    // its free space
+    std::unique_ptr<char[]> block(new char[length]);
+    memcpy(block.get(), begin, length);
+    char const* string = block.get();
+    blocks_.insert(blocks_.empty() ? blocks_.end() : blocks_.end() - 1,
+                   std::move(block));
+    return string;
+  }
+  if (blocks_.empty() || blockSize - used_ < length) {
+    blocks_.emplace_back(new char[blockSize]);
+    used_ = 0;
+  }
+  char* string = blocks_.back().get() + used_;
+  memcpy(string, begin, length);
+  used_ += length;
+  return string;
+}
+
 // Implementation of class Reader
 // ////////////////////////////////
 
@@ -1200,6 +1319,8 @@ private:
   bool decodeNumber(Token& token, Value& decoded);
   bool decodeString(Token& token);
   bool decodeString(Token& token, String& decoded);
+  // Finds the string's characters, in the document unless it has escapes
+  bool decodeString(Token& token, Location& begin, Location& end);
   bool decodeDouble(Token& token);
   bool decodeDouble(Token& token, Value& decoded);
   bool decodeUnicodeCodePoint(Token& token,
@@ -1230,6 +1351,7 @@ private:
   using Nodes = std::stack<Value*>;
   Nodes nodes_;
   Errors errors_;
+  StringArena arena_;
   String document_;
   Location begin_;
   Location end_;
@@ -1272,6 +1394,7 @@ bool OurReader::parse(const char* beginDoc,
   lastValue_ = nullptr;
   commentsBefore_.clear();
   errors_.clear();
+  arena_.clear();
   while (!nodes_.empty())
     nodes_.pop();
   nodes_.push(&root);
@@ -1666,6 +1789,10 @@ bool OurReader::readStringSingleQuote() {
 bool OurReader::readObject(Token& token) {
   Token tokenName;
   String name;
+  // The name, in name unless it is borrowed from the document
+  Location nameBegin = nullptr;
+  Location nameEnd = nullptr;
+  bool borrowed = false;
   Value init(objectValue);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(token.start_ - begin_);
@@ -1675,24 +1802,33 @@ bool OurReader::readObject(Token& token) {
       initialTokenOk = readToken(tokenName);
     if (!initialTokenOk)
       break;
-    if (tokenName.type_ == tokenObjectEnd && name.empty()) // empty object
-      return true;
-    name.clear();
-    if (tokenName.type_ == tokenString) {
-      if (!decodeString(tokenName, name))
+    if (tokenName.type_ == tokenObjectEnd && nameBegin == nameEnd) // empty
+      return true;                                                  // object
+    borrowed = tokenName.type_ == tokenString && features_.inSitu_;
+    if (borrowed) {
+      if (!decodeString(tokenName, nameBegin, nameEnd))
         return recoverFromError(tokenObjectEnd);
-    } else if (tokenName.type_ == tokenNumber && features_.allowNumericKeys_) {
-      Value numberName;
-      if (!decodeNumber(tokenName, numberName))
-        return recoverFromError(tokenObjectEnd);
-      name = numberName.asString();
     } else {
-      break;
+      name.clear();
+      if (tokenName.type_ == tokenString) {
+        if (!decodeString(tokenName, name))
+          return recoverFromError(tokenObjectEnd);
+      } else if (tokenName.type_ == tokenNumber &&
+                 features_.allowNumericKeys_) {
+        Value numberName;
+        if (!decodeNumber(tokenName, numberName))
+          return recoverFromError(tokenObjectEnd);
+        name = numberName.asString();
+      } else {
+        break;
+      }
+      nameBegin = name.data();
+      nameEnd = nameBegin + name.length();
     }
-    if (name.length() >= (1U << 30))
+    if (static_cast<size_t>(nameEnd - nameBegin) >= (1U << 30))
       throwRuntimeError("keylength >= 2^30");
-    if (features_.rejectDupKeys_ && currentValue().isMember(name)) {
-      String msg = "Duplicate key: '" + name + "'";
+    if (features_.rejectDupKeys_ && currentValue().find(nameBegin, nameEnd)) {
+      String msg = "Duplicate key: '" + String(nameBegin, nameEnd) + "'";
       return addErrorAndRecover(msg, tokenName, tokenObjectEnd);
     }
 
@@ -1701,7 +1837,9 @@ bool OurReader::readObject(Token& token) {
       return addErrorAndRecover("Missing ':' after object member name", colon,
                                 tokenObjectEnd);
     }
-    Value& value = currentValue()[name];
+    Value& value = borrowed
+                       ? currentValue()[BorrowedString(nameBegin, nameEnd)]
+                       : currentValue()[name];
     nodes_.push(&value);
     bool ok = readValue();
     nodes_.pop();
@@ -1833,16 +1971,12 @@ bool OurReader::decodeDouble(Token& token) {
   return true;
 }
 
-bool OurReader::decodeDouble(Token& token, Value& decoded) {
-  double value = 0;
+// Parses [begin, end) as a double. Shared by OurReader and
+// StructuralIndexReader.
+static bool parseDouble(char const* begin, char const* end, double& value) {
   const int bufferSize = 32;
   int count;
-  ptrdiff_t const length = token.end_ - token.start_;
-
-  // Sanity check to avoid buffer overflow exploits.
-  if (length < 0) {
-    return addError("Unable to parse token length", token);
-  }
+  ptrdiff_t const length = end - begin;
   auto const ulength = static_cast<size_t>(length);
 
   // Avoid using a string constant for the format control string given to
@@ -1853,17 +1987,28 @@ bool OurReader::decodeDouble(Token& token, Value& decoded) {
   char format[] = "%lf";
 
   if (length <= bufferSize) {
-    Char buffer[bufferSize + 1];
-    memcpy(buffer, token.start_, ulength);
+    char buffer[bufferSize + 1];
+    memcpy(buffer, begin, ulength);
     buffer[length] = 0;
     fixNumericLocaleInput(buffer, buffer + length);
     count = sscanf(buffer, format, &value);
   } else {
-    String buffer(token.start_, token.end_);
+    String buffer(begin, end);
     count = sscanf(buffer.c_str(), format, &value);
   }
+  return count == 1;
+}
+
+bool OurReader::decodeDouble(Token& token, Value& decoded) {
+  double value = 0;
+  ptrdiff_t const length = token.end_ - token.start_;
+
+  // Sanity check to avoid buffer overflow exploits.
+  if (length < 0) {
+    return addError("Unable to parse token length", token);
+  }
 
-  if (count != 1)
+  if (!parseDouble(token.start_, token.end_, value))
     return addError(
         "'" + String(token.start_, token.end_) + "' is not a number.", token);
   decoded = value;
@@ -1871,16 +2016,38 @@ bool OurReader::decodeDouble(Token& token, Value& decoded) {
 }
 
 bool OurReader::decodeString(Token& token) {
-  String decoded_string;
-  if (!decodeString(token, decoded_string))
-    return false;
-  Value decoded(decoded_string);
+  Value decoded;
+  if (features_.inSitu_) {
+    Location begin;
+    Location end;
+    if (!decodeString(token, begin, end))
+      return false;
+    decoded = Value(BorrowedString(begin, end));
+  } else {
+    String decoded_string;
+    if (!decodeString(token, decoded_string))
+      return false;
+    decoded = Value(decoded_string);
+  }
   currentValue().swapPayload(decoded);
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
   return true;
 }
 
+bool OurReader::decodeString(Token& token, Location& begin, Location& end) {
+  begin = token.start_ + 1; // skip '"'
+  end = token.end_ - 1;     // do not include '"'
+  if (!memchr(begin, '\\', static_cast<size_t>(end - begin)))
+    return true;
+  String decoded;
+  if (!decodeString(token, decoded))
+    return false;
+  begin = arena_.store(decoded.data(), decoded.data() + decoded.length());
+  end = begin + decoded.length();
+  return true;
+}
+
 bool OurReader::decodeString(Token& token, String& decoded) {
   decoded.reserve(static_cast<size_t>(token.end_ - token.start_ - 2));
   Location current = token.start_ + 1; // skip '"'
@@ -2137,6 +2304,683 @@ public:
   }
 };
 
+// Implementation of class StructuralIndexReader
+// ////////////////////////////////
+//
+// Reads strict JSON in two stages, after simdjson. The first stage classifies
+// the input 64 characters at a time (with SIMD where available) and records
+// the position of every structural character ({}[]:,) and of the first
+// character of every string and scalar, outside of strings. The second stage
+// walks these positions to build the Value tree, and only looks at the
+// characters of strings and scalars. Positions are indexed a batch at a time,
+// so that both stages work on input that is still in cache and the index does
+// not grow with the input.
+
+// Bit masks of the characters of a 64-character block.
+struct BlockMasks {
+  uint64_t backslash;
+  uint64_t quote;
+  uint64_t whitespace;
+  uint64_t op; // {}[]:,
+};
+
+#if defined(JSONCPP_HAS_AVX2)
+static uint64_t movemask64(__m256i low, __m256i high) {
+  auto const lowBits = static_cast<uint32_t>(_mm256_movemask_epi8(low));
+  auto const highBits = static_cast<uint32_t>(_mm256_movemask_epi8(high));
+  return lowBits | static_cast<uint64_t>(highBits) << 32;
+}
+
+static void classifyBlock(char const* block, BlockMasks& masks) {
+  __m256i chars[2];
+  __m256i backslash[2], quote[2], whitespace[2], op[2];
+  for (int i = 0; i < 2; ++i) {
+    chars[i] =
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(block) + i);
+    // '[' and ']' only differ from '{' and '}' by 0x20
+    __m256i lower = _mm256_or_si256(chars[i], _mm256_set1_epi8(0x20));
+    backslash[i] = _mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8('\\'));
+    quote[i] = _mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8('"'));
+    whitespace[i] = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8('\r'))));
+    op[i] = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')),
+                        _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8(':')),
+                        _mm256_cmpeq_epi8(chars[i], _mm256_set1_epi8(','))));
+  }
+  masks.backslash = movemask64(backslash[0], backslash[1]);
+  masks.quote = movemask64(quote[0], quote[1]);
+  masks.whitespace = movemask64(whitespace[0], whitespace[1]);
+  masks.op = movemask64(op[0], op[1]);
+}
+#elif defined(JSONCPP_HAS_SSE2)
+static uint64_t movemask16(__m128i m) {
+  return static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(m)));
+}
+
+static void classifyBlock(char const* block, BlockMasks& masks) {
+  masks = BlockMasks();
+  for (int i = 0; i < 4; ++i) {
+    __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(block) + i);
+    // '[' and ']' only differ from '{' and '}' by 0x20
+    __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i backslash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'));
+    __m128i quote = _mm_cmpeq_epi8(chars, _mm_set1_epi8('"'));
+    __m128i whitespace =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                  _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')),
+                                  _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))));
+    __m128i op =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                                  _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(':')),
+                                  _mm_cmpeq_epi8(chars, _mm_set1_epi8(','))));
+    int shift = 16 * i;
+    masks.backslash |= movemask16(backslash) << shift;
+    masks.quote |= movemask16(quote) << shift;
+    masks.whitespace |= movemask16(whitespace) << shift;
+    masks.op |= movemask16(op) << shift;
+  }
+}
+#else
+static void classifyBlock(char const* block, BlockMasks& masks) {
+  masks = BlockMasks();
+  for (unsigned i = 0; i < 64; ++i) {
+    uint64_t bit = uint64_t(1) << i;
+    switch (block[i]) {
+    case '\\':
+      masks.backslash |= bit;
+      break;
+    case '"':
+      masks.quote |= bit;
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      masks.whitespace |= bit;
+      break;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+      masks.op |= bit;
+      break;
+    default:
+      break;
+    }
+  }
+}
+#endif
+
+// Each bit of the result is the xor of the bits of x up to and including it.
+static inline uint64_t prefixXor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+class StructuralIndex {
+public:
+  StructuralIndex(char const* begin, char const* end)
+      : end_(end), next_(begin) {}
+
+  // Returns the next structural position, or end if there is none left.
+  char const* peek() {
+    if (current_ == positions_.size() && !refill())
+      return end_;
+    return positions_[current_];
+  }
+  char const* next() {
+    char const* position = peek();
+    if (position != end_)
+      ++current_;
+    return position;
+  }
+
+  // True if the input ended inside a string. Only known once peek() has
+  // returned end.
+  bool unterminatedString() const { return inString_ != 0; }
+
+private:
+  static size_t const maxBlocksPerBatch = 256;
+
+  bool refill();
+  void indexBlock(char const* block, char const* position);
+
+  char const* const end_;
+  char const* next_; // Next block to index
+  std::vector<char const*> positions_;
+  size_t current_{0};
+
+  // State carried between blocks
+  uint64_t escaped_{0};  // The first character is escaped
+  uint64_t inString_{0}; // All ones if the block starts inside a string
+  uint64_t inScalar_{0}; // The last character continues a scalar
+  // Batches start small, so that skipping a short value (see LazyValue) does
+  // not index far past its end
+  size_t blocksPerBatch_{1};
+};
+
+bool StructuralIndex::refill() {
+  positions_.clear();
+  current_ = 0;
+  while (positions_.empty() && next_ != end_) {
+    for (size_t i = 0; i < blocksPerBatch_ && next_ != end_; ++i) {
+      if (end_ - next_ >= 64) {
+        indexBlock(next_, next_);
+        next_ += 64;
+      } else {
+        // Pad the last block with whitespace
+        char block[64];
+        memset(block, ' ', sizeof(block));
+        memcpy(block, next_, static_cast<size_t>(end_ - next_));
+        indexBlock(block, next_);
+        next_ = end_;
+      }
+    }
+    if (blocksPerBatch_ < maxBlocksPerBatch)
+      blocksPerBatch_ *= 2;
+  }
+  return !positions_.empty();
+}
+
+void StructuralIndex::indexBlock(char const* block, char const* position) {
+  BlockMasks masks;
+  classifyBlock(block, masks);
+
+  // Characters escaped by an odd-length run of backslashes
+  uint64_t escaped = 0;
+  if (masks.backslash | escaped_) {
+    static uint64_t const oddBits = 0xAAAAAAAAAAAAAAAAULL;
+    // Backslashes that are not themselves escaped may start an escape. The
+    // subtraction flips the bits of each run of backslashes from its start,
+    // so that xoring with the odd bits marks every other backslash of a run
+    // (and the character after an odd-length run) as escaped.
+    uint64_t potential = masks.backslash & ~escaped_;
+    uint64_t escapeAndTerminal =
+        (((potential << 1) | oddBits) - potential) ^ oddBits;
+    escaped = escapeAndTerminal ^ (masks.backslash | escaped_);
+    escaped_ = (escapeAndTerminal & masks.backslash) >> 63;
+  }
+
+  uint64_t quote = masks.quote & ~escaped;
+  // Opening quotes and the characters of strings (but not closing quotes)
+  uint64_t inString = prefixXor(quote) ^ inString_;
+  inString_ = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+  uint64_t stringTail = inString ^ quote;
+
+  uint64_t scalar = ~(masks.op | masks.whitespace);
+  uint64_t nonQuoteScalar = scalar & ~quote;
+  uint64_t followsScalar = (nonQuoteScalar << 1) | inScalar_;
+  inScalar_ = nonQuoteScalar >> 63;
+
+  uint64_t structural = (masks.op | (scalar & ~followsScalar)) & ~stringTail;
+  while (structural) {
+    positions_.push_back(position + countTrailingZeros(structural));
+    structural &= structural - 1;
+  }
+}
+
+class StructuralIndexReader {
+public:
+  explicit StructuralIndexReader(OurFeatures const& features)
+      : features_(features) {}
+
+  bool parse(char const* beginDoc, char const* endDoc, Value& root);
+  String getFormattedErrorMessages() const;
+
+private:
+  bool readValue(char const* token, Value& value, size_t depth);
+  bool readObject(char const* token, Value& value, size_t depth);
+  bool readArray(char const* token, Value& value, size_t depth);
+  bool readScalar(char const* token, Value& value);
+  // Finds the closing quote of the string starting at token, and decodes it
+  // into scratch_ if it has escapes.
+  bool readString(char const* token, char const*& end, bool& escaped);
+  bool decodeString(char const* begin, char const* end);
+  bool decodeUnicodeEscape(char const*& current,
+                           char const* end,
+                           unsigned int& unicode);
+  bool addError(String const& message, char const* location);
+
+  OurFeatures const features_;
+  char const* begin_{nullptr};
+  char const* end_{nullptr};
+  std::unique_ptr<StructuralIndex> index_;
+  StringArena arena_;
+  String scratch_;
+  String error_;
+  char const* errorLocation_{nullptr};
+};
+
+bool StructuralIndexReader::parse(char const* beginDoc,
+                                  char const* endDoc,
+                                  Value& root) {
+  begin_ = beginDoc;
+  end_ = endDoc;
+  error_.clear();
+  errorLocation_ = nullptr;
+  arena_.clear();
+  index_.reset(new StructuralIndex(beginDoc, endDoc));
+
+  if (!readValue(index_->next(), root, 0))
+    return false;
+  if (features_.failIfExtra_ && index_->peek() != end_)
+    return addError("Extra non-whitespace after JSON value.", index_->peek());
+  if (features_.strictRoot_ && !root.isArray() && !root.isObject())
+    return addError(
+        "A valid JSON document must be either an array or an object value.",
+        begin_);
+  return true;
+}
+
+bool StructuralIndexReader::readValue(char const* token,
+                                      Value& value,
+                                      size_t depth) {
+  if (depth > features_.stackLimit_)
+    throwRuntimeError("Exceeded stackLimit in readValue().");
+  if (token == end_)
+    return addError("Syntax error: value, object or array expected.", token);
+
+  switch (*token) {
+  case '{':
+    return readObject(token, value, depth);
+  case '[':
+    return readArray(token, value, depth);
+  case '"': {
+    char const* end;
+    bool escaped;
+    if (!readString(token, end, escaped))
+      return false;
+    char const* stringBegin = token + 1;
+    char const* stringEnd = end - 1;
+    if (escaped) {
+      stringBegin = scratch_.data();
+      stringEnd = stringBegin + scratch_.size();
+    }
+    Value decoded;
+    if (!features_.inSitu_) {
+      decoded = Value(stringBegin, stringEnd);
+    } else {
+      if (escaped) {
+        stringBegin = arena_.store(stringBegin, stringEnd);
+        stringEnd = stringBegin + scratch_.size();
+      }
+      decoded = Value(BorrowedString(stringBegin, stringEnd));
+    }
+    value.swapPayload(decoded);
+    value.setOffsetStart(token - begin_);
+    value.setOffsetLimit(end - begin_);
+    return true;
+  }
+  case '}':
+  case ']':
+  case ':':
+  case ',':
+    return addError("Syntax error: value, object or array expected.", token);
+  default:
+    return readScalar(token, value);
+  }
+}
+
+bool StructuralIndexReader::readObject(char const* token,
+                                       Value& value,
+                                       size_t depth) {
+  Value init(objectValue);
+  value.swapPayload(init);
+  value.setOffsetStart(token - begin_);
+  char const* current = index_->next();
+  if (current != end_ && *current == '}') {
+    value.setOffsetLimit(current + 1 - begin_);
+    return true;
+  }
+  for (;;) {
+    if (current == end_ || *current != '"')
+      return addError("Missing '}' or object member name", current);
+    char const* nameEnd;
+    bool escaped;
+    if (!readString(current, nameEnd, escaped))
+      return false;
+    char const* nameBegin = current + 1;
+    --nameEnd;
+    if (escaped) {
+      nameBegin = scratch_.data();
+      nameEnd = nameBegin + scratch_.size();
+    }
+
+    char const* colon = index_->next();
+    if (colon == end_ || *colon != ':')
+      return addError("Missing ':' after object member name", colon);
+    if (features_.rejectDupKeys_ && value.find(nameBegin, nameEnd))
+      return addError("Duplicate key: '" + String(nameBegin, nameEnd) + "'",
+                      current);
+    if (features_.inSitu_ && escaped) {
+      nameBegin = arena_.store(nameBegin, nameEnd);
+      nameEnd = nameBegin + scratch_.size();
+    }
+    Value& member = features_.inSitu_
+                        ? value[BorrowedString(nameBegin, nameEnd)]
+                        : *value.demand(nameBegin, nameEnd);
+    if (!readValue(index_->next(), member, depth + 1))
+      return false;
+
+    current = index_->next();
+    if (current != end_ && *current == '}') {
+      value.setOffsetLimit(current + 1 - begin_);
+      return true;
+    }
+    if (current == end_ || *current != ',')
+      return addError("Missing ',' or '}' in object declaration", current);
+    current = index_->next();
+  }
+}
+
+bool StructuralIndexReader::readArray(char const* token,
+                                      Value& value,
+                                      size_t depth) {
+  Value init(arrayValue);
+  value.swapPayload(init);
+  value.setOffsetStart(token - begin_);
+  char const* current = index_->peek();
+  if (current != end_ && *current == ']') {
+    index_->next();
+    value.setOffsetLimit(current + 1 - begin_);
+    return true;
+  }
+  for (;;) {
+    Value& element = value.append(Value());
+    if (!readValue(index_->next(), element, depth + 1))
+      return false;
+
+    current = index_->next();
+    if (current != end_ && *current == ']') {
+      value.setOffsetLimit(current + 1 - begin_);
+      return true;
+    }
+    if (current == end_ || *current != ',')
+      return addError("Missing ',' or ']' in array declaration", current);
+  }
+}
+
+static inline bool isJSONWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool StructuralIndexReader::readString(char const* token,
+                                       char const*& end,
+                                       bool& escaped) {
+  // Only whitespace separates a closing quote from the next structural
+  end = index_->peek();
+  while (end != token + 1 && isJSONWhitespace(end[-1]))
+    --end;
+  if (end == token + 1 || end[-1] != '"' ||
+      (end == end_ && index_->unterminatedString()))
+    return addError("Missing '\"' at the end of string", token);
+
+  escaped = memchr(token + 1, '\\',
+                   static_cast<size_t>(end - 1 - (token + 1))) != nullptr;
+  return !escaped || decodeString(token + 1, end - 1);
+}
+
+bool StructuralIndexReader::decodeString(char const* begin, char const* end) {
+  scratch_.clear();
+  char const* current = begin;
+  while (current != end) {
+    char const* backslash = static_cast<char const*>(
+        memchr(current, '\\', static_cast<size_t>(end - current)));
+    if (!backslash) {
+      scratch_.append(current, end);
+      break;
+    }
+    scratch_.append(current, backslash);
+    current = backslash + 1;
+    if (current == end)
+      return addError("Empty escape sequence in string", current);
+    char escape = *current++;
+    switch (escape) {
+    case '"':
+      scratch_ += '"';
+      break;
+    case '/':
+      scratch_ += '/';
+      break;
+    case '\\':
+      scratch_ += '\\';
+      break;
+    case 'b':
+      scratch_ += '\b';
+      break;
+    case 'f':
+      scratch_ += '\f';
+      break;
+    case 'n':
+      scratch_ += '\n';
+      break;
+    case 'r':
+      scratch_ += '\r';
+      break;
+    case 't':
+      scratch_ += '\t';
+      break;
+    case 'u': {
+      unsigned int unicode;
+      if (!decodeUnicodeEscape(current, end, unicode))
+        return false;
+      if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+        // surrogate pairs
+        unsigned int surrogatePair;
+        if (end - current < 6 || current[0] != '\\' || current[1] != 'u')
+          return addError("expecting another \\u token to begin the second "
+                          "half of a unicode surrogate pair",
+                          current);
+        current += 2;
+        if (!decodeUnicodeEscape(current, end, surrogatePair))
+          return false;
+        unicode = 0x10000 + ((unicode & 0x3FF) << 10) + (surrogatePair & 0x3FF);
+      }
+      scratch_ += codePointToUTF8(unicode);
+    } break;
+    default:
+      return addError("Bad escape sequence in string", current - 1);
+    }
+  }
+  return true;
+}
+
+bool StructuralIndexReader::decodeUnicodeEscape(char const*& current,
+                                                char const* end,
+                                                unsigned int& unicode) {
+  if (end - current < 4)
+    return addError(
+        "Bad unicode escape sequence in string: four digits expected.",
+        current);
+  unicode = 0;
+  for (int index = 0; index < 4; ++index) {
+    char c = *current++;
+    unicode *= 16;
+    if (c >= '0' && c <= '9')
+      unicode += static_cast<unsigned int>(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      unicode += static_cast<unsigned int>(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      unicode += static_cast<unsigned int>(c - 'A' + 10);
+    else
+      return addError(
+          "Bad unicode escape sequence in string: hexadecimal digit expected.",
+          current - 1);
+  }
+  return true;
+}
+
+bool StructuralIndexReader::readScalar(char const* token, Value& value) {
+  char const* end = index_->peek();
+  while (isJSONWhitespace(end[-1]))
+    --end;
+  size_t const length = static_cast<size_t>(end - token);
+  value.setOffsetStart(token - begin_);
+  value.setOffsetLimit(end - begin_);
+
+  switch (*token) {
+  case 't':
+    if (length == 4 && memcmp(token, "true", 4) == 0) {
+      Value v(true);
+      value.swapPayload(v);
+      return true;
+    }
+    break;
+  case 'f':
+    if (length == 5 && memcmp(token, "false", 5) == 0) {
+      Value v(false);
+      value.swapPayload(v);
+      return true;
+    }
+    break;
+  case 'n':
+    if (length == 4 && memcmp(token, "null", 4) == 0) {
+      Value v;
+      value.swapPayload(v);
+      return true;
+    }
+    break;
+  default:
+    break;
+  }
+
+  // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  char const* current = token;
+  bool const isNegative = current != end && *current == '-';
+  if (isNegative)
+    ++current;
+  char const* digits = current;
+  while (current != end && *current >= '0' && *current <= '9')
+    ++current;
+  bool valid = current != digits && (*digits != '0' || current == digits + 1);
+  bool const isInteger = current == end;
+  if (valid && current != end && *current == '.') {
+    char const* fraction = ++current;
+    while (current != end && *current >= '0' && *current <= '9')
+      ++current;
+    valid = current != fraction;
+  }
+  if (valid && current != end && (*current == 'e' || *current == 'E')) {
+    ++current;
+    if (current != end && (*current == '+' || *current == '-'))
+      ++current;
+    char const* exponent = current;
+    while (current != end && *current >= '0' && *current <= '9')
+      ++current;
+    valid = current != exponent;
+  }
+  if (!valid || current != end)
+    return addError("Syntax error: value, object or array expected.", token);
+
+  if (isInteger && end - digits <= 19) {
+    // At most 19 digits always fit in a LargestUInt
+    Value::LargestUInt magnitude = 0;
+    for (current = digits; current != end; ++current)
+      magnitude = magnitude * 10 + static_cast<unsigned>(*current - '0');
+    Value v;
+    if (isNegative) {
+      if (magnitude <= Value::LargestUInt(Value::maxLargestInt) + 1) {
+        v = magnitude ? -Value::LargestInt(magnitude - 1) - 1 : 0;
+        value.swapPayload(v);
+        return true;
+      }
+    } else {
+      if (magnitude <= Value::LargestUInt(Value::maxLargestInt))
+        v = Value::LargestInt(magnitude);
+      else
+        v = magnitude;
+      value.swapPayload(v);
+      return true;
+    }
+  }
+  if (isInteger && !isNegative && end - digits == 20) {
+    // Integers up to maxLargestUInt (20 digits) are not doubles either
+    Value::LargestUInt magnitude = 0;
+    bool overflow = false;
+    for (current = digits; current != end; ++current) {
+      auto const digit = static_cast<unsigned>(*current - '0');
+      if (magnitude > (Value::maxLargestUInt - digit) / 10) {
+        overflow = true;
+        break;
+      }
+      magnitude = magnitude * 10 + digit;
+    }
+    if (!overflow) {
+      Value v(magnitude);
+      value.swapPayload(v);
+      return true;
+    }
+  }
+
+  double number = 0;
+  if (!parseDouble(token, end, number))
+    return addError("'" + String(token, end) + "' is not a number.", token);
+  Value v(number);
+  value.swapPayload(v);
+  return true;
+}
+
+bool StructuralIndexReader::addError(String const& message,
+                                     char const* location) {
+  if (errorLocation_ == nullptr) {
+    error_ = message;
+    errorLocation_ = location;
+  }
+  return false;
+}
+
+String StructuralIndexReader::getFormattedErrorMessages() const {
+  if (errorLocation_ == nullptr)
+    return String();
+  // column & line start at 1
+  int line = 1;
+  char const* lineStart = begin_;
+  for (char const* current = begin_; current < errorLocation_; ++current) {
+    if (*current == '\n' ||
+        (*current == '\r' && (current + 1 == end_ || current[1] != '\n'))) {
+      ++line;
+      lineStart = current + 1;
+    }
+  }
+  char buffer[18 + 16 + 16 + 1];
+  jsoncpp_snprintf(buffer, sizeof(buffer), "Line %d, Column %d", line,
+                   int(errorLocation_ - lineStart) + 1);
+  return "* " + String(buffer) + "\n  " + error_ + "\n";
+}
+
+class StructuralIndexCharReader : public CharReader {
+  StructuralIndexReader reader_;
+
+public:
+  explicit StructuralIndexCharReader(OurFeatures const& features)
+      : reader_(features) {}
+  bool parse(char const* beginDoc,
+             char const* endDoc,
+             Value* root,
+             String* errs) override {
+    bool ok = reader_.parse(beginDoc, endDoc, *root);
+    if (errs) {
+      *errs = reader_.getFormattedErrorMessages();
+    }
+    return ok;
+  }
+};
+
 CharReaderBuilder::CharReaderBuilder() { setDefaults(&settings_); }
 CharReaderBuilder::~CharReaderBuilder() = default;
 CharReader* CharReaderBuilder::newCharReader() const {
@@ -2155,6 +2999,9 @@ CharReader* CharReaderBuilder::newCharReader() const {
   features.failIfExtra_ = settings_["failIfExtra"].asBool();
   features.rejectDupKeys_ = settings_["rejectDupKeys"].asBool();
   features.allowSpecialFloats_ = settings_["allowSpecialFloats"].asBool();
+  features.inSitu_ = settings_["inSitu"].asBool();
+  if (settings_["structuralIndex"].asBool())
+    return new StructuralIndexCharReader(features);
   return new OurCharReader(collectComments, features);
 }
 static void getValidReaderKeys(std::set<String>* valid_keys) {
@@ -2169,6 +3016,8 @@ static void getValidReaderKeys(std::set<String>* valid_keys) {
   valid_keys->insert("failIfExtra");
   valid_keys->insert("rejectDupKeys");
   valid_keys->insert("allowSpecialFloats");
+  valid_keys->insert("structuralIndex");
+  valid_keys->insert("inSitu");
 }
 bool CharReaderBuilder::validate(Json::Value* invalid) const {
   Json::Value my_invalid;
@@ -2217,6 +3066,8 @@ void CharReaderBuilder::setDefaults(Json::Value* settings) {
   (*settings)["failIfExtra"] = false;
   (*settings)["rejectDupKeys"] = false;
   (*settings)["allowSpecialFloats"] = false;
+  (*settings)["structuralIndex"] = false;
+  (*settings)["inSitu"] = false;
   //! [CharReaderBuilderDefaults]
 }
 
@@ -2247,6 +3098,190 @@ IStream& operator>>(IStream& sin, Value& root) {
   return sin;
 }
 
+//////////////////////////////////
+// class LazyValue
+
+static char const* skipJSONWhitespace(char const* current, char const* end) {
+  while (current != end && isJSONWhitespace(*current))
+    ++current;
+  return current;
+}
+
+// Return the end of the string starting at begin (a quote)
+static char const* skipJSONString(char const* begin, char const* end) {
+  char const* current = begin + 1;
+  for (;;) {
+    auto quote = static_cast<char const*>(
+        memchr(current, '"', static_cast<size_t>(end - current)));
+    if (!quote)
+      throwRuntimeError("Missing '\"' at the end of string");
+    // The quote is escaped if an odd number of backslashes precede it
+    char const* backslashes = quote;
+    while (backslashes != begin + 1 && backslashes[-1] == '\\')
+      --backslashes;
+    if ((quote - backslashes) % 2 == 0)
+      return quote + 1;
+    current = quote + 1;
+  }
+}
+
+// Return the end of the value starting at begin
+static char const* skipJSONValue(char const* begin, char const* end) {
+  switch (*begin) {
+  case '"':
+    return skipJSONString(begin, end);
+  case '{':
+  case '[': {
+    // Only brackets outside of strings are indexed
+    StructuralIndex index(begin, end);
+    size_t depth = 0;
+    for (char const* current = index.next(); current != end;
+         current = index.next()) {
+      if (*current == '{' || *current == '[')
+        ++depth;
+      else if ((*current == '}' || *current == ']') && --depth == 0)
+        return current + 1;
+    }
+    throwRuntimeError("Missing ']' or '}'");
+  }
+  case '}':
+  case ']':
+  case ':':
+  case ',':
+    throwRuntimeError("Syntax error: value, object or array expected.");
+  default: {
+    char const* current = begin;
+    while (current != end && !isJSONWhitespace(*current) && *current != ',' &&
+           *current != ']' && *current != '}')
+      ++current;
+    return current;
+  }
+  }
+}
+
+LazyValue::LazyValue(char const* beginDoc, char const* endDoc)
+    : begin_(skipJSONWhitespace(beginDoc, endDoc)), endDoc_(endDoc) {
+  if (begin_ == endDoc_)
+    throwRuntimeError("Syntax error: value, object or array expected.");
+}
+
+bool LazyValue::isNull() const { return *begin_ == 'n'; }
+bool LazyValue::isBool() const { return *begin_ == 't' || *begin_ == 'f'; }
+bool LazyValue::isNumeric() const {
+  return *begin_ == '-' || (*begin_ >= '0' && *begin_ <= '9');
+}
+bool LazyValue::isString() const { return *begin_ == '"'; }
+bool LazyValue::isArray() const { return *begin_ == '['; }
+bool LazyValue::isObject() const { return *begin_ == '{'; }
+
+LazyValue::const_iterator LazyValue::begin() const {
+  JSON_ASSERT_MESSAGE(isArray() || isObject(),
+                      "in Json::LazyValue::begin(): requires arrayValue or "
+                      "objectValue");
+  return const_iterator(skipJSONWhitespace(begin_ + 1, endDoc_), endDoc_,
+                        isObject());
+}
+
+LazyValue::const_iterator LazyValue::end() const { return const_iterator(); }
+
+bool LazyValue::find(String const& key, LazyValue* member) const {
+  JSON_ASSERT_MESSAGE(isObject(),
+                      "in Json::LazyValue::find(): requires objectValue");
+  for (const_iterator it = begin(), itEnd = end(); it != itEnd; ++it) {
+    if (it.hasName(key)) {
+      *member = *it;
+      return true;
+    }
+  }
+  return false;
+}
+
+String LazyValue::asString() const {
+  JSON_ASSERT_MESSAGE(isString(),
+                      "in Json::LazyValue::asString(): requires stringValue");
+  char const* end = skipJSONString(begin_, endDoc_);
+  if (!memchr(begin_ + 1, '\\', static_cast<size_t>(end - 1 - (begin_ + 1))))
+    return String(begin_ + 1, end - 1);
+
+  // Let the reader decode the escapes
+  StructuralIndexReader reader(OurFeatures::all());
+  Value decoded;
+  if (!reader.parse(begin_, end, decoded))
+    throwRuntimeError(reader.getFormattedErrorMessages());
+  return decoded.asString();
+}
+
+bool LazyValue::parse(CharReader::Factory const& factory,
+                      Value* root,
+                      String* errs) const {
+  CharReaderPtr const reader(factory.newCharReader());
+  return reader->parse(begin_, skip(), root, errs);
+}
+
+char const* LazyValue::skip() const { return skipJSONValue(begin_, endDoc_); }
+
+LazyValue::const_iterator::const_iterator(char const* current,
+                                          char const* endDoc,
+                                          bool isObject)
+    : current_(current), endDoc_(endDoc), isObject_(isObject) {
+  if (current_ != endDoc_ && (*current_ == ']' || *current_ == '}'))
+    current_ = nullptr; // empty
+  else
+    read();
+}
+
+void LazyValue::const_iterator::read() {
+  if (current_ == endDoc_)
+    throwRuntimeError("Syntax error: value, object or array expected.");
+  if (!isObject_) {
+    value_ = current_;
+    return;
+  }
+  if (*current_ != '"')
+    throwRuntimeError("Missing '}' or object member name");
+  char const* colon =
+      skipJSONWhitespace(skipJSONString(current_, endDoc_), endDoc_);
+  if (colon == endDoc_ || *colon != ':')
+    throwRuntimeError("Missing ':' after object member name");
+  value_ = skipJSONWhitespace(colon + 1, endDoc_);
+  if (value_ == endDoc_)
+    throwRuntimeError("Syntax error: value, object or array expected.");
+}
+
+LazyValue LazyValue::const_iterator::operator*() const {
+  return LazyValue(value_, endDoc_);
+}
+
+String LazyValue::const_iterator::name() const {
+  JSON_ASSERT_MESSAGE(isObject_, "in Json::LazyValue::const_iterator::name(): "
+                                 "requires objectValue");
+  return LazyValue(current_, endDoc_).asString();
+}
+
+bool LazyValue::const_iterator::hasName(String const& name) const {
+  char const* end = skipJSONString(current_, endDoc_);
+  auto const length = static_cast<size_t>(end - 1 - (current_ + 1));
+  if (!memchr(current_ + 1, '\\', length))
+    return length == name.length() &&
+           memcmp(current_ + 1, name.data(), length) == 0;
+  return this->name() == name;
+}
+
+LazyValue::const_iterator& LazyValue::const_iterator::operator++() {
+  char const* next =
+      skipJSONWhitespace(skipJSONValue(value_, endDoc_), endDoc_);
+  if (next != endDoc_ && *next == (isObject_ ? '}' : ']')) {
+    current_ = nullptr;
+    return *this;
+  }
+  if (next == endDoc_ || *next != ',')
+    throwRuntimeError(isObject_ ? "Missing ',' or '}' in object declaration"
+                                : "Missing ',' or ']' in array declaration");
+  current_ = skipJSONWhitespace(next + 1, endDoc_);
+  read();
+  return *this;
+}
+
 } // namespace Json
 
 // //////////////////////////////////////////////////////////////////////
@@ -2285,53 +3320,64 @@ ValueIteratorBase::ValueIteratorBase(
     const Value::ObjectValues::iterator& current)
     : current_(current), isNull_(false) {}
 
-Value& ValueIteratorBase::deref() const { return current_->second; }
+ValueIteratorBase::ValueIteratorBase(Value* element, Value* first)
+    : current_(), element_(element), first_(first), isNull_(false),
+      isArray_(true) {}
 
-void ValueIteratorBase::increment() { ++current_; }
+Value& ValueIteratorBase::deref() const {
+  if (isArray_)
+    return *element_;
+  return current_->second;
+}
+
+void ValueIteratorBase::increment() {
+  if (isArray_)
+    ++element_;
+  else
+    ++current_;
+}
 
-void ValueIteratorBase::decrement() { --current_; }
+void ValueIteratorBase::decrement() {
+  if (isArray_)
+    --element_;
+  else
+    --current_;
+}
 
 ValueIteratorBase::difference_type
 ValueIteratorBase::computeDistance(const SelfType& other) const {
-#ifdef JSON_USE_CPPTL_SMALLMAP
-  return other.current_ - current_;
-#else
+  if (isArray_)
+    return difference_type(other.element_ - element_);
   // Iterator for null value are initialized using the default
-  // constructor, which initialize current_ to the default
-  // std::map::iterator. As begin() and end() are two instance
-  // of the default std::map::iterator, they can not be compared.
-  // To allow this, we handle this comparison specifically.
+  // constructor, which initialize current_ to a singular iterator.
+  // As begin() and end() are two singular iterators, they can not be
+  // subtracted. To allow this, we handle this comparison specifically.
   if (isNull_ && other.isNull_) {
     return 0;
   }
-
-  // Usage of std::distance is not portable (does not compile with Sun Studio 12
-  // RogueWave STL,
-  // which is the one used by default).
-  // Using a portable hand-made version for non random iterator instead:
-  //   return difference_type( std::distance( current_, other.current_ ) );
-  difference_type myDistance = 0;
-  for (Value::ObjectValues::iterator it = current_; it != other.current_;
-       ++it) {
-    ++myDistance;
-  }
-  return myDistance;
-#endif
+  return difference_type(other.current_ - current_);
 }
 
 bool ValueIteratorBase::isEqual(const SelfType& other) const {
   if (isNull_) {
     return other.isNull_;
   }
+  if (isArray_)
+    return element_ == other.element_;
   return current_ == other.current_;
 }
 
 void ValueIteratorBase::copy(const SelfType& other) {
   current_ = other.current_;
+  element_ = other.element_;
+  first_ = other.first_;
   isNull_ = other.isNull_;
+  isArray_ = other.isArray_;
 }
 
 Value ValueIteratorBase::key() const {
+  if (isArray_)
+    return Value(index());
   const Value::CZString czstring = (*current_).first;
   if (czstring.data()) {
     if (czstring.isStaticString())
@@ -2342,6 +3388,8 @@ Value ValueIteratorBase::key() const {
 }
 
 UInt ValueIteratorBase::index() const {
+  if (isArray_)
+    return UInt(element_ - first_);
   const Value::CZString czstring = (*current_).first;
   if (!czstring.data())
     return czstring.index();
@@ -2358,11 +3406,17 @@ String ValueIteratorBase::name() const {
 }
 
 char const* ValueIteratorBase::memberName() const {
+  if (isArray_)
+    return "";
   const char* cname = (*current_).first.data();
   return cname ? cname : "";
 }
 
 char const* ValueIteratorBase::memberName(char const** end) const {
+  if (isArray_) {
+    *end = nullptr;
+    return nullptr;
+  }
   const char* cname = (*current_).first.data();
   if (!cname) {
     *end = nullptr;
@@ -2372,6 +3426,10 @@ char const* ValueIteratorBase::memberName(char const** end) const {
   return cname;
 }
 
+bool ValueIteratorBase::isPlainInternedName() const {
+  return !isArray_ && (*current_).first.isInterned();
+}
+
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
@@ -2386,6 +3444,9 @@ ValueConstIterator::ValueConstIterator(
     const Value::ObjectValues::iterator& current)
     : ValueIteratorBase(current) {}
 
+ValueConstIterator::ValueConstIterator(Value* element, Value* first)
+    : ValueIteratorBase(element, first) {}
+
 ValueConstIterator::ValueConstIterator(ValueIterator const& other)
     : ValueIteratorBase(other) {}
 
@@ -2408,6 +3469,9 @@ ValueIterator::ValueIterator() = default;
 ValueIterator::ValueIterator(const Value::ObjectValues::iterator& current)
     : ValueIteratorBase(current) {}
 
+ValueIterator::ValueIterator(Value* element, Value* first)
+    : ValueIteratorBase(element, first) {}
+
 ValueIterator::ValueIterator(const ValueConstIterator& other)
     : ValueIteratorBase(other) {
   throwRuntimeError("ConstIterator to Iterator should never be allowed.");
@@ -2455,6 +3519,9 @@ ValueIterator& ValueIterator::operator=(const SelfType& other) {
 #endif
 #include <algorithm> // min()
 #include <cstddef>   // size_t
+#include <mutex>
+#include <new>
+#include <set>
 
 // Provide implementation equivalent of std::snprintf for older _MSC compilers
 #if defined(_MSC_VER) && _MSC_VER < 1900
@@ -2553,15 +3620,19 @@ static inline bool InRange(double d, T min, U max) {
  *              length is "unknown".
  * @param length Length of the value. if equals to unknown, then it will be
  *               computed using strlen(value).
+ * @param arena Arena to allocate the duplicate in, or null to malloc it.
  * @return Pointer on the duplicate instance of string.
  */
-static inline char* duplicateStringValue(const char* value, size_t length) {
+static inline char* duplicateStringValue(const char* value,
+                                         size_t length,
+                                         Arena* arena) {
   // Avoid an integer overflow in the call to malloc below by limiting length
   // to a sane value.
   if (length >= static_cast<size_t>(Value::maxInt))
     length = Value::maxInt - 1;
 
-  char* newString = static_cast<char*>(malloc(length + 1));
+  char* newString = static_cast<char*>(
+      arena ? arena->allocate(length + 1, 1) : malloc(length + 1));
   if (newString == nullptr) {
     throwRuntimeError("in Json::Value::duplicateStringValue(): "
                       "Failed to allocate string value buffer");
@@ -2574,7 +3645,8 @@ static inline char* duplicateStringValue(const char* value, size_t length) {
 /* Record the length as a prefix.
  */
 static inline char* duplicateAndPrefixStringValue(const char* value,
-                                                  unsigned int length) {
+                                                  unsigned int length,
+                                                  Arena* arena) {
   // Avoid an integer overflow in the call to malloc below by limiting length
   // to a sane value.
   JSON_ASSERT_MESSAGE(length <= static_cast<unsigned>(Value::maxInt) -
@@ -2582,7 +3654,9 @@ static inline char* duplicateAndPrefixStringValue(const char* value,
                       "in Json::Value::duplicateAndPrefixStringValue(): "
                       "length too big for prefixing");
   unsigned actualLength = length + static_cast<unsigned>(sizeof(unsigned)) + 1U;
-  char* newString = static_cast<char*>(malloc(actualLength));
+  char* newString = static_cast<char*>(
+      arena ? arena->allocate(actualLength, alignof(unsigned))
+            : malloc(actualLength));
   if (newString == nullptr) {
     throwRuntimeError("in Json::Value::duplicateAndPrefixStringValue(): "
                       "Failed to allocate string value buffer");
@@ -2659,6 +3733,74 @@ LogicError::LogicError(String const& msg) : Exception(msg) {}
 [[noreturn]] void throwLogicError(String const& msg) { abort(); }
 #endif
 
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Arena
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+static thread_local Arena* currentArena = nullptr;
+
+static char* alignUp(char* p, size_t alignment) {
+  uintptr_t bits = reinterpret_cast<uintptr_t>(p);
+  return reinterpret_cast<char*>((bits + alignment - 1) & ~(alignment - 1));
+}
+
+Arena::Scope::Scope(Arena& arena) : previous_(currentArena) {
+  currentArena = &arena;
+}
+
+Arena::Scope::~Scope() { currentArena = previous_; }
+
+Arena::Arena(size_t blockSize)
+    : next_(nullptr), end_(nullptr), blockSize_(blockSize) {}
+
+Arena::~Arena() = default;
+
+void* Arena::allocate(size_t size, size_t alignment) {
+  if (next_) {
+    char* p = alignUp(next_, alignment);
+    if (p <= end_ && size <= static_cast<size_t>(end_ - p)) {
+      next_ = p + size;
+      return p;
+    }
+  }
+
+  // Large allocations get a block of their own, so that the rest of the
+  // current block is not wasted
+  if (size > blockSize_ / 4) {
+    blocks_.emplace_back(new char[size + alignment]);
+    return alignUp(blocks_.back().get(), alignment);
+  }
+
+  blocks_.emplace_back(new char[blockSize_]);
+  char* p = alignUp(blocks_.back().get(), alignment);
+  next_ = p + size;
+  end_ = blocks_.back().get() + blockSize_;
+  return p;
+}
+
+Arena* Arena::current() { return currentArena; }
+
+// Containers are allocated in the current arena, if any, like their elements
+template <typename T> static T* newContainer(Arena* arena, T const* other) {
+  if (!arena)
+    return other ? new T(*other) : new T();
+  void* p = arena->allocate(sizeof(T), alignof(T));
+  return other ? new (p) T(*other) : new (p) T();
+}
+
+// Arena containers only have their elements destroyed; their memory is
+// released with the arena
+template <typename T> static void deleteContainer(T* container, bool inArena) {
+  if (inArena)
+    container->~T();
+  else
+    delete container;
+}
+
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
@@ -2677,27 +3819,21 @@ Value::CZString::CZString(char const* str,
                           DuplicationPolicy allocate)
     : cstr_(str) {
   // allocate != duplicate
-  storage_.policy_ = allocate & 0x3;
-  storage_.length_ = length & 0x3FFFFFFF;
-}
-
-Value::CZString::CZString(const CZString& other) {
-  cstr_ = (other.storage_.policy_ != noDuplication && other.cstr_ != nullptr
-               ? duplicateStringValue(other.cstr_, other.storage_.length_)
-               : other.cstr_);
-  storage_.policy_ =
-      static_cast<unsigned>(
-          other.cstr_
-              ? (static_cast<DuplicationPolicy>(other.storage_.policy_) ==
-                         noDuplication
-                     ? noDuplication
-                     : duplicate)
-              : static_cast<DuplicationPolicy>(other.storage_.policy_)) &
-      3U;
-  storage_.length_ = other.storage_.length_;
-}
-
-Value::CZString::CZString(CZString&& other)
+  storage_.policy_ = allocate & 0x7;
+  storage_.length_ = length & 0x1FFFFFFF;
+}
+
+Value::CZString::CZString(const CZString& other)
+    : cstr_(other.cstr_), index_(other.index_) {
+  // Copies own their strings, unless they are static or interned
+  if (!cstr_ || other.isStaticString())
+    return;
+  Arena* arena = Arena::current();
+  cstr_ = duplicateStringValue(other.cstr_, other.storage_.length_, arena);
+  storage_.policy_ = (arena ? duplicateInArena : duplicate) & 0x7;
+}
+
+Value::CZString::CZString(CZString&& other) JSONCPP_NOEXCEPT
     : cstr_(other.cstr_), index_(other.index_) {
   other.cstr_ = nullptr;
 }
@@ -2723,10 +3859,10 @@ Value::CZString& Value::CZString::operator=(const CZString& other) {
   return *this;
 }
 
-Value::CZString& Value::CZString::operator=(CZString&& other) {
-  cstr_ = other.cstr_;
-  index_ = other.index_;
-  other.cstr_ = nullptr;
+Value::CZString&
+Value::CZString::operator=(CZString&& other) JSONCPP_NOEXCEPT {
+  // Hand our string to other, so that it is released with other
+  swap(other);
   return *this;
 }
 
@@ -2739,6 +3875,8 @@ bool Value::CZString::operator<(const CZString& other) const {
   unsigned other_len = other.storage_.length_;
   unsigned min_len = std::min<unsigned>(this_len, other_len);
   JSON_ASSERT(this->cstr_ && other.cstr_);
+  if (this->cstr_ == other.cstr_)
+    return this_len < other_len;
   int comp = memcmp(this->cstr_, other.cstr_, min_len);
   if (comp < 0)
     return true;
@@ -2757,6 +3895,9 @@ bool Value::CZString::operator==(const CZString& other) const {
   if (this_len != other_len)
     return false;
   JSON_ASSERT(this->cstr_ && other.cstr_);
+  // Interned keys are the same characters
+  if (this->cstr_ == other.cstr_)
+    return true;
   int comp = memcmp(this->cstr_, other.cstr_, this_len);
   return comp == 0;
 }
@@ -2767,7 +3908,313 @@ ArrayIndex Value::CZString::index() const { return index_; }
 const char* Value::CZString::data() const { return cstr_; }
 unsigned Value::CZString::length() const { return storage_.length_; }
 bool Value::CZString::isStaticString() const {
-  return storage_.policy_ == noDuplication;
+  return storage_.policy_ == noDuplication || storage_.policy_ == interned;
+}
+bool Value::CZString::isInterned() const {
+  return storage_.policy_ == interned;
+}
+
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class InternedKey
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+// Return the interned copy of [begin, end), adding it if needed. The table is
+// never destroyed, so that keys outlive any static Value
+static String const& internKey(char const* begin, char const* end) {
+  static std::mutex mutex;
+  static std::set<String>* keys = new std::set<String>();
+  std::lock_guard<std::mutex> lock(mutex);
+  return *keys->emplace(begin, end).first;
+}
+
+// Whether a writer has to escape any of the characters
+static bool hasEscapedChar(char const* begin, char const* end) {
+  for (char const* c = begin; c != end; ++c) {
+    unsigned char u = static_cast<unsigned char>(*c);
+    if (u == '\\' || u == '"' || u < 0x20 || u >= 0x80)
+      return true;
+  }
+  return false;
+}
+
+InternedKey::InternedKey(const char* key)
+    : InternedKey(key, key + strlen(key)) {}
+
+InternedKey::InternedKey(const char* begin, const char* end) {
+  String const& key = internKey(begin, end);
+  data_ = key.c_str();
+  length_ = static_cast<unsigned>(key.length());
+  plain_ = !hasEscapedChar(begin, end);
+}
+
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class Value::ObjectValues
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+// FNV-1a
+static size_t hashKey(char const* key, unsigned length) {
+  uint32_t hash = 2166136261u;
+  for (unsigned i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Erased members keep their slot, with an index key (rather than a string)
+// and a null value, so that the members after them do not move
+static const ArrayIndex erasedKey = ArrayIndex(-1);
+
+static bool isErased(Value::ObjectValues::value_type const& member) {
+  return member.first.data() == nullptr;
+}
+
+Value::ObjectValues::ObjectValues(const ObjectValues& other) {
+  // Copies allocate in the current arena (as containers do), and are compacted
+  for (auto const& member : other) {
+    new (appendSlot()) value_type(member);
+    ++slots_;
+  }
+  if (!other.erased_)
+    index_.assign(other.index_.begin(), other.index_.end());
+  else
+    rebuildIndex();
+}
+
+Value::ObjectValues::~ObjectValues() { clear(); }
+
+void Value::ObjectValues::clear() {
+  for (size_t pos = 0; pos < slots_; ++pos)
+    slot(pos).~value_type();
+  ArenaAllocator<value_type> allocator(index_.get_allocator());
+  if (first_)
+    allocator.deallocate(first_, firstChunkSize);
+  if (chunks_) {
+    size_t count = numChunks();
+    for (size_t chunk = 0; chunk < count; ++chunk)
+      allocator.deallocate(chunks_[chunk], firstChunkSize << chunk);
+    ArenaAllocator<value_type*>(allocator).deallocate(chunks_, count);
+  }
+  first_ = nullptr;
+  chunks_ = nullptr;
+  slots_ = 0;
+  erased_ = 0;
+  decltype(index_)(index_.get_allocator()).swap(index_);
+}
+
+// The number of chunks after the first. Chunk i starts at (and holds)
+// firstChunkSize << i slots
+size_t Value::ObjectValues::numChunks() const {
+  return slots_ <= firstChunkSize ? 0
+                                  : floorLog2((slots_ - 1) / firstChunkSize) + 1;
+}
+
+Value::ObjectValues::value_type*
+Value::ObjectValues::locate(size_t pos, value_type** chunkEnd) const {
+  if (pos < firstChunkSize) {
+    *chunkEnd = first_ + firstChunkSize;
+    return first_ + pos;
+  }
+  unsigned chunk = floorLog2(pos / firstChunkSize);
+  size_t start = firstChunkSize << chunk;
+  *chunkEnd = chunks_[chunk] + start;
+  return chunks_[chunk] + (pos - start);
+}
+
+Value::ObjectValues::value_type& Value::ObjectValues::slot(size_t pos) {
+  value_type* chunkEnd;
+  return *locate(pos, &chunkEnd);
+}
+
+Value::ObjectValues::value_type const&
+Value::ObjectValues::slot(size_t pos) const {
+  value_type* chunkEnd;
+  return *locate(pos, &chunkEnd);
+}
+
+// Return the (unconstructed) slot after the last one, adding a chunk if needed
+Value::ObjectValues::value_type* Value::ObjectValues::appendSlot() {
+  ArenaAllocator<value_type> allocator(index_.get_allocator());
+  if (!first_) {
+    first_ = allocator.allocate(firstChunkSize);
+  } else if (slots_ >= firstChunkSize &&
+             slots_ == firstChunkSize << numChunks()) {
+    // The chunk pointers are reallocated, but never the chunks
+    size_t count = numChunks();
+    ArenaAllocator<value_type*> pointerAllocator(allocator);
+    value_type** chunks = pointerAllocator.allocate(count + 1);
+    std::copy(chunks_, chunks_ + count, chunks);
+    chunks[count] = allocator.allocate(firstChunkSize << count);
+    if (chunks_)
+      pointerAllocator.deallocate(chunks_, count);
+    chunks_ = chunks;
+  }
+  return &slot(slots_);
+}
+
+size_t Value::ObjectValues::firstLive() const {
+  size_t pos = 0;
+  while (erased_ && pos < slots_ && isErased(slot(pos)))
+    ++pos;
+  return pos;
+}
+
+size_t Value::ObjectValues::nextLive(size_t pos) const {
+  do
+    ++pos;
+  while (erased_ && pos < slots_ && isErased(slot(pos)));
+  return pos;
+}
+
+size_t Value::ObjectValues::previousLive(size_t pos) const {
+  do
+    --pos;
+  while (erased_ && isErased(slot(pos)));
+  return pos;
+}
+
+std::ptrdiff_t Value::ObjectValues::distance(size_t from, size_t to) const {
+  if (!erased_)
+    return std::ptrdiff_t(to) - std::ptrdiff_t(from);
+  std::ptrdiff_t live = 0;
+  for (size_t pos = std::min(from, to); pos < std::max(from, to); ++pos)
+    live += !isErased(slot(pos));
+  return to < from ? -live : live;
+}
+
+size_t Value::ObjectValues::position(const CZString& key) const {
+  if (index_.empty()) {
+    // Search a chunk at a time. Later chunks hold as many slots as precede them
+    for (size_t start = 0, chunk = 0; start < slots_; ++chunk) {
+      value_type const* members = chunk ? chunks_[chunk - 1] : first_;
+      size_t chunkSize = chunk ? start : firstChunkSize;
+      size_t count = std::min<size_t>(chunkSize, slots_ - start);
+      for (size_t i = 0; i < count; ++i) {
+        if (!isErased(members[i]) && members[i].first == key)
+          return start + i;
+      }
+      start += chunkSize;
+    }
+    return slots_;
+  }
+
+  size_t mask = index_.size() - 1;
+  for (size_t entry = hashKey(key.data(), key.length()) & mask;;
+       entry = (entry + 1) & mask) {
+    ArrayIndex pos = index_[entry];
+    if (pos == 0)
+      return slots_;
+    if (slot(pos - 1).first == key)
+      return pos - 1;
+  }
+}
+
+Value::ObjectValues::iterator Value::ObjectValues::find(const CZString& key) {
+  return iterator(this, position(key));
+}
+
+Value::ObjectValues::const_iterator
+Value::ObjectValues::find(const CZString& key) const {
+  return const_iterator(this, position(key));
+}
+
+void Value::ObjectValues::addToIndex(size_t pos) {
+  // Keep the table at most half full
+  if (index_.size() < 2 * size_t(slots_)) {
+    rebuildIndex();
+    return;
+  }
+
+  const CZString& key = slot(pos).first;
+  size_t mask = index_.size() - 1;
+  size_t entry = hashKey(key.data(), key.length()) & mask;
+  while (index_[entry] != 0)
+    entry = (entry + 1) & mask;
+  index_[entry] = ArrayIndex(pos + 1);
+}
+
+void Value::ObjectValues::rebuildIndex() {
+  if (size() <= maxLinearSize) {
+    decltype(index_)(index_.get_allocator()).swap(index_);
+    return;
+  }
+
+  size_t tableSize = 64;
+  while (tableSize < 4 * size_t(slots_))
+    tableSize *= 2;
+  index_.assign(tableSize, 0);
+  size_t mask = tableSize - 1;
+  for (size_t pos = 0; pos < slots_; ++pos) {
+    const CZString& key = slot(pos).first;
+    if (!key.data())
+      continue;
+    size_t entry = hashKey(key.data(), key.length()) & mask;
+    while (index_[entry] != 0)
+      entry = (entry + 1) & mask;
+    index_[entry] = ArrayIndex(pos + 1);
+  }
+}
+
+Value& Value::ObjectValues::insert(CZString key, Value&& value) {
+  value_type* member = appendSlot();
+  new (member) value_type(std::move(key), std::move(value));
+  ++slots_;
+  if (!index_.empty() || size() > maxLinearSize)
+    addToIndex(slots_ - 1);
+  return member->second;
+}
+
+void Value::ObjectValues::erase(iterator it) {
+  // Release the key and value now, but keep the slot
+  it->first = CZString(erasedKey);
+  it->second = Value();
+  ++erased_;
+  if (!index_.empty())
+    rebuildIndex();
+}
+
+// Return the object's members, sorted by key
+static std::vector<Value::ObjectValues::value_type const*>
+sortedMembers(Value::ObjectValues const& members) {
+  std::vector<Value::ObjectValues::value_type const*> sorted;
+  sorted.reserve(members.size());
+  for (auto const& member : members)
+    sorted.push_back(&member);
+  std::sort(sorted.begin(), sorted.end(),
+            [](Value::ObjectValues::value_type const* a,
+               Value::ObjectValues::value_type const* b) {
+              return a->first < b->first;
+            });
+  return sorted;
+}
+
+bool Value::ObjectValues::operator==(const ObjectValues& other) const {
+  if (size() != other.size())
+    return false;
+  for (auto const& member : *this) {
+    auto it = other.find(member.first);
+    if (it == other.end() || !(it->second == member.second))
+      return false;
+  }
+  return true;
+}
+
+bool Value::ObjectValues::operator<(const ObjectValues& other) const {
+  auto thisSorted = sortedMembers(*this);
+  auto otherSorted = sortedMembers(other);
+  return std::lexicographical_compare(
+      thisSorted.begin(), thisSorted.end(), otherSorted.begin(),
+      otherSorted.end(),
+      [](Value::ObjectValues::value_type const* a,
+         Value::ObjectValues::value_type const* b) { return *a < *b; });
 }
 
 // //////////////////////////////////////////////////////////////////
@@ -2800,8 +4247,12 @@ Value::Value(ValueType type) {
     value_.string_ = const_cast<char*>(static_cast<char const*>(emptyString));
     break;
   case arrayValue:
+    value_.array_ = newContainer<ArrayValues>(Arena::current(), nullptr);
+    bits_.arena_ = Arena::current() != nullptr;
+    break;
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = newContainer<ObjectValues>(Arena::current(), nullptr);
+    bits_.arena_ = Arena::current() != nullptr;
     break;
   case booleanValue:
     value_.bool_ = false;
@@ -2837,23 +4288,20 @@ Value::Value(double value) {
 }
 
 Value::Value(const char* value) {
-  initBasic(stringValue, true);
+  initBasic(stringValue);
   JSON_ASSERT_MESSAGE(value != nullptr,
                       "Null Value Passed to Value Constructor");
-  value_.string_ = duplicateAndPrefixStringValue(
-      value, static_cast<unsigned>(strlen(value)));
+  dupString(value, static_cast<unsigned>(strlen(value)));
 }
 
 Value::Value(const char* begin, const char* end) {
-  initBasic(stringValue, true);
-  value_.string_ =
-      duplicateAndPrefixStringValue(begin, static_cast<unsigned>(end - begin));
+  initBasic(stringValue);
+  dupString(begin, static_cast<unsigned>(end - begin));
 }
 
 Value::Value(const String& value) {
-  initBasic(stringValue, true);
-  value_.string_ = duplicateAndPrefixStringValue(
-      value.data(), static_cast<unsigned>(value.length()));
+  initBasic(stringValue);
+  dupString(value.data(), static_cast<unsigned>(value.length()));
 }
 
 Value::Value(const StaticString& value) {
@@ -2861,11 +4309,17 @@ Value::Value(const StaticString& value) {
   value_.string_ = const_cast<char*>(value.c_str());
 }
 
+Value::Value(const BorrowedString& value) {
+  initBasic(stringValue);
+  bits_.borrowed_ = true;
+  bits_.borrowedLength_ = static_cast<unsigned>(value.end() - value.begin());
+  value_.string_ = const_cast<char*>(value.begin());
+}
+
 #ifdef JSON_USE_CPPTL
 Value::Value(const CppTL::ConstString& value) {
-  initBasic(stringValue, true);
-  value_.string_ = duplicateAndPrefixStringValue(
-      value, static_cast<unsigned>(value.length()));
+  initBasic(stringValue);
+  dupString(value, static_cast<unsigned>(value.length()));
 }
 #endif
 
@@ -2879,7 +4333,7 @@ Value::Value(const Value& other) {
   dupMeta(other);
 }
 
-Value::Value(Value&& other) {
+Value::Value(Value&& other) JSONCPP_NOEXCEPT {
   initBasic(nullValue);
   swap(other);
 }
@@ -2894,7 +4348,7 @@ Value& Value::operator=(const Value& other) {
   return *this;
 }
 
-Value& Value::operator=(Value&& other) {
+Value& Value::operator=(Value&& other) JSONCPP_NOEXCEPT {
   other.swap(*this);
   return *this;
 }
@@ -2959,10 +4413,8 @@ bool Value::operator<(const Value& other) const {
     unsigned other_len;
     char const* this_str;
     char const* other_str;
-    decodePrefixedString(this->isAllocated(), this->value_.string_, &this_len,
-                         &this_str);
-    decodePrefixedString(other.isAllocated(), other.value_.string_, &other_len,
-                         &other_str);
+    this->stringData(&this_len, &this_str);
+    other.stringData(&other_len, &other_str);
     unsigned min_len = std::min<unsigned>(this_len, other_len);
     JSON_ASSERT(this_str && other_str);
     int comp = memcmp(this_str, other_str, min_len);
@@ -2972,7 +4424,12 @@ bool Value::operator<(const Value& other) const {
       return false;
     return (this_len < other_len);
   }
-  case arrayValue:
+  case arrayValue: {
+    int delta = int(value_.array_->size() - other.value_.array_->size());
+    if (delta)
+      return delta < 0;
+    return (*value_.array_) < (*other.value_.array_);
+  }
   case objectValue: {
     int delta = int(value_.map_->size() - other.value_.map_->size());
     if (delta)
@@ -3013,10 +4470,8 @@ bool Value::operator==(const Value& other) const {
     unsigned other_len;
     char const* this_str;
     char const* other_str;
-    decodePrefixedString(this->isAllocated(), this->value_.string_, &this_len,
-                         &this_str);
-    decodePrefixedString(other.isAllocated(), other.value_.string_, &other_len,
-                         &other_str);
+    this->stringData(&this_len, &this_str);
+    other.stringData(&other_len, &other_str);
     if (this_len != other_len)
       return false;
     JSON_ASSERT(this_str && other_str);
@@ -3024,6 +4479,7 @@ bool Value::operator==(const Value& other) const {
     return comp == 0;
   }
   case arrayValue:
+    return (*value_.array_) == (*other.value_.array_);
   case objectValue:
     return value_.map_->size() == other.value_.map_->size() &&
            (*value_.map_) == (*other.value_.map_);
@@ -3038,12 +4494,13 @@ bool Value::operator!=(const Value& other) const { return !(*this == other); }
 const char* Value::asCString() const {
   JSON_ASSERT_MESSAGE(type() == stringValue,
                       "in Json::Value::asCString(): requires stringValue");
+  JSON_ASSERT_MESSAGE(!bits_.borrowed_,
+                      "in Json::Value::asCString(): requires an owned string");
   if (value_.string_ == nullptr)
     return nullptr;
   unsigned this_len;
   char const* this_str;
-  decodePrefixedString(this->isAllocated(), this->value_.string_, &this_len,
-                       &this_str);
+  this->stringData(&this_len, &this_str);
   return this_str;
 }
 
@@ -3055,20 +4512,27 @@ unsigned Value::getCStringLength() const {
     return 0;
   unsigned this_len;
   char const* this_str;
-  decodePrefixedString(this->isAllocated(), this->value_.string_, &this_len,
-                       &this_str);
+  this->stringData(&this_len, &this_str);
   return this_len;
 }
 #endif
 
+void Value::stringData(unsigned* length, char const** value) const {
+  if (bits_.borrowed_) {
+    *length = bits_.borrowedLength_;
+    *value = value_.string_;
+  } else {
+    decodePrefixedString(isAllocated(), value_.string_, length, value);
+  }
+}
+
 bool Value::getString(char const** begin, char const** end) const {
   if (type() != stringValue)
     return false;
   if (value_.string_ == nullptr)
     return false;
   unsigned length;
-  decodePrefixedString(this->isAllocated(), this->value_.string_, &length,
-                       begin);
+  this->stringData(&length, begin);
   *end = *begin + length;
   return true;
 }
@@ -3082,8 +4546,7 @@ String Value::asString() const {
       return "";
     unsigned this_len;
     char const* this_str;
-    decodePrefixedString(this->isAllocated(), this->value_.string_, &this_len,
-                         &this_str);
+    this->stringData(&this_len, &this_str);
     return String(this_str, this_len);
   }
   case booleanValue:
@@ -3103,7 +4566,7 @@ String Value::asString() const {
 CppTL::ConstString Value::asConstString() const {
   unsigned len;
   char const* str;
-  decodePrefixedString(isAllocated(), value_.string_, &len, &str);
+  stringData(&len, &str);
   return CppTL::ConstString(str, len);
 }
 #endif
@@ -3285,7 +4748,7 @@ bool Value::isConvertibleTo(ValueType other) const {
     return (isNumeric() && asDouble() == 0.0) ||
            (type() == booleanValue && value_.bool_ == false) ||
            (type() == stringValue && asString().empty()) ||
-           (type() == arrayValue && value_.map_->empty()) ||
+           (type() == arrayValue && value_.array_->empty()) ||
            (type() == objectValue && value_.map_->empty()) ||
            type() == nullValue;
   case intValue:
@@ -3322,13 +4785,8 @@ ArrayIndex Value::size() const {
   case booleanValue:
   case stringValue:
     return 0;
-  case arrayValue: // size of the array is highest index + 1
-    if (!value_.map_->empty()) {
-      ObjectValues::const_iterator itLast = value_.map_->end();
-      --itLast;
-      return (*itLast).first.index() + 1;
-    }
-    return 0;
+  case arrayValue:
+    return ArrayIndex(value_.array_->size());
   case objectValue:
     return ArrayIndex(value_.map_->size());
   }
@@ -3353,6 +4811,8 @@ void Value::clear() {
   limit_ = 0;
   switch (type()) {
   case arrayValue:
+    value_.array_->clear();
+    break;
   case objectValue:
     value_.map_->clear();
     break;
@@ -3366,17 +4826,10 @@ void Value::resize(ArrayIndex newSize) {
                       "in Json::Value::resize(): requires arrayValue");
   if (type() == nullValue)
     *this = Value(arrayValue);
-  ArrayIndex oldSize = size();
   if (newSize == 0)
     clear();
-  else if (newSize > oldSize)
-    this->operator[](newSize - 1);
-  else {
-    for (ArrayIndex index = newSize; index < oldSize; ++index) {
-      value_.map_->erase(index);
-    }
-    JSON_ASSERT(size() == newSize);
-  }
+  else
+    value_.array_->resize(newSize);
 }
 
 Value& Value::operator[](ArrayIndex index) {
@@ -3385,14 +4838,9 @@ Value& Value::operator[](ArrayIndex index) {
       "in Json::Value::operator[](ArrayIndex): requires arrayValue");
   if (type() == nullValue)
     *this = Value(arrayValue);
-  CZString key(index);
-  auto it = value_.map_->lower_bound(key);
-  if (it != value_.map_->end() && (*it).first == key)
-    return (*it).second;
-
-  ObjectValues::value_type defaultValue(key, nullSingleton());
-  it = value_.map_->insert(it, defaultValue);
-  return (*it).second;
+  if (index >= value_.array_->size())
+    value_.array_->resize(index + 1);
+  return (*value_.array_)[index];
 }
 
 Value& Value::operator[](int index) {
@@ -3406,13 +4854,9 @@ const Value& Value::operator[](ArrayIndex index) const {
   JSON_ASSERT_MESSAGE(
       type() == nullValue || type() == arrayValue,
       "in Json::Value::operator[](ArrayIndex)const: requires arrayValue");
-  if (type() == nullValue)
+  if (type() == nullValue || index >= value_.array_->size())
     return nullSingleton();
-  CZString key(index);
-  ObjectValues::const_iterator it = value_.map_->find(key);
-  if (it == value_.map_->end())
-    return nullSingleton();
-  return (*it).second;
+  return (*value_.array_)[index];
 }
 
 const Value& Value::operator[](int index) const {
@@ -3425,14 +4869,27 @@ const Value& Value::operator[](int index) const {
 void Value::initBasic(ValueType type, bool allocated) {
   setType(type);
   setIsAllocated(allocated);
+  bits_.borrowed_ = false;
+  bits_.arena_ = false;
+  bits_.borrowedLength_ = 0;
   comments_ = Comments{};
   start_ = 0;
   limit_ = 0;
 }
 
+void Value::dupString(char const* value, unsigned length) {
+  Arena* arena = Arena::current();
+  value_.string_ = duplicateAndPrefixStringValue(value, length, arena);
+  setIsAllocated(true);
+  bits_.arena_ = arena != nullptr;
+}
+
 void Value::dupPayload(const Value& other) {
   setType(other.type());
   setIsAllocated(false);
+  bits_.borrowed_ = false;
+  bits_.arena_ = false;
+  bits_.borrowedLength_ = 0;
   switch (type()) {
   case nullValue:
   case intValue:
@@ -3442,20 +4899,26 @@ void Value::dupPayload(const Value& other) {
     value_ = other.value_;
     break;
   case stringValue:
-    if (other.value_.string_ && other.isAllocated()) {
+    // Copies own their strings, so they do not outlive borrowed ones
+    if (other.value_.string_ &&
+        (other.isAllocated() || other.bits_.borrowed_)) {
       unsigned len;
       char const* str;
-      decodePrefixedString(other.isAllocated(), other.value_.string_, &len,
-                           &str);
-      value_.string_ = duplicateAndPrefixStringValue(str, len);
-      setIsAllocated(true);
+      other.stringData(&len, &str);
+      dupString(str, len);
     } else {
       value_.string_ = other.value_.string_;
     }
     break;
   case arrayValue:
+    value_.array_ =
+        newContainer<ArrayValues>(Arena::current(), other.value_.array_);
+    bits_.arena_ = Arena::current() != nullptr;
+    break;
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    value_.map_ =
+        newContainer<ObjectValues>(Arena::current(), other.value_.map_);
+    bits_.arena_ = Arena::current() != nullptr;
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -3471,12 +4934,14 @@ void Value::releasePayload() {
   case booleanValue:
     break;
   case stringValue:
-    if (isAllocated())
+    if (isAllocated() && !bits_.arena_)
       releasePrefixedStringValue(value_.string_);
     break;
   case arrayValue:
+    deleteContainer(value_.array_, bits_.arena_);
+    break;
   case objectValue:
-    delete value_.map_;
+    deleteContainer(value_.map_, bits_.arena_);
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -3500,14 +4965,11 @@ Value& Value::resolveReference(const char* key) {
     *this = Value(objectValue);
   CZString actualKey(key, static_cast<unsigned>(strlen(key)),
                      CZString::noDuplication); // NOTE!
-  auto it = value_.map_->lower_bound(actualKey);
-  if (it != value_.map_->end() && (*it).first == actualKey)
+  auto it = value_.map_->find(actualKey);
+  if (it != value_.map_->end())
     return (*it).second;
 
-  ObjectValues::value_type defaultValue(actualKey, nullSingleton());
-  it = value_.map_->insert(it, defaultValue);
-  Value& value = (*it).second;
-  return value;
+  return value_.map_->insert(actualKey, Value());
 }
 
 // @param key is not null-terminated.
@@ -3519,14 +4981,11 @@ Value& Value::resolveReference(char const* key, char const* end) {
     *this = Value(objectValue);
   CZString actualKey(key, static_cast<unsigned>(end - key),
                      CZString::duplicateOnCopy);
-  auto it = value_.map_->lower_bound(actualKey);
-  if (it != value_.map_->end() && (*it).first == actualKey)
+  auto it = value_.map_->find(actualKey);
+  if (it != value_.map_->end())
     return (*it).second;
 
-  ObjectValues::value_type defaultValue(actualKey, nullSingleton());
-  it = value_.map_->insert(it, defaultValue);
-  Value& value = (*it).second;
-  return value;
+  return value_.map_->insert(actualKey, Value());
 }
 
 Value Value::get(ArrayIndex index, const Value& defaultValue) const {
@@ -3580,6 +5039,39 @@ Value& Value::operator[](const StaticString& key) {
   return resolveReference(key.c_str());
 }
 
+Value& Value::operator[](const BorrowedString& key) {
+  JSON_ASSERT_MESSAGE(
+      type() == nullValue || type() == objectValue,
+      "in Json::Value::operator[](BorrowedString): requires objectValue");
+  if (type() == nullValue)
+    *this = Value(objectValue);
+  CZString actualKey(key.begin(),
+                     static_cast<unsigned>(key.end() - key.begin()),
+                     CZString::duplicateOnCopy);
+  auto it = value_.map_->find(actualKey);
+  if (it != value_.map_->end())
+    return (*it).second;
+
+  // Moving the key keeps it borrowed; copying it would duplicate it
+  return value_.map_->insert(std::move(actualKey), Value());
+}
+
+Value& Value::operator[](const InternedKey& key) {
+  JSON_ASSERT_MESSAGE(
+      type() == nullValue || type() == objectValue,
+      "in Json::Value::operator[](InternedKey): requires objectValue");
+  if (type() == nullValue)
+    *this = Value(objectValue);
+  CZString actualKey(key.data(), key.length(),
+                     key.plain_ ? CZString::interned
+                                : CZString::noDuplication);
+  auto it = value_.map_->find(actualKey);
+  if (it != value_.map_->end())
+    return (*it).second;
+
+  return value_.map_->insert(std::move(actualKey), Value());
+}
+
 #ifdef JSON_USE_CPPTL
 Value& Value::operator[](const CppTL::ConstString& key) {
   return resolveReference(key.c_str(), key.end_c_str());
@@ -3599,7 +5091,8 @@ Value& Value::append(Value&& value) {
   if (type() == nullValue) {
     *this = Value(arrayValue);
   }
-  return this->value_.map_->emplace(size(), std::move(value)).first->second;
+  value_.array_->push_back(std::move(value));
+  return value_.array_->back();
 }
 
 Value Value::get(char const* begin,
@@ -3642,7 +5135,9 @@ void Value::removeMember(const char* key) {
     return;
 
   CZString actualKey(key, unsigned(strlen(key)), CZString::noDuplication);
-  value_.map_->erase(actualKey);
+  auto it = value_.map_->find(actualKey);
+  if (it != value_.map_->end())
+    value_.map_->erase(it);
 }
 void Value::removeMember(const String& key) { removeMember(key.c_str()); }
 
@@ -3650,23 +5145,14 @@ bool Value::removeIndex(ArrayIndex index, Value* removed) {
   if (type() != arrayValue) {
     return false;
   }
-  CZString key(index);
-  auto it = value_.map_->find(key);
-  if (it == value_.map_->end()) {
+  if (index >= value_.array_->size()) {
     return false;
   }
+  auto it = value_.array_->begin() + index;
   if (removed)
-    *removed = it->second;
-  ArrayIndex oldSize = size();
-  // shift left all items left, into the place of the "removed"
-  for (ArrayIndex i = index; i < (oldSize - 1); ++i) {
-    CZString keey(i);
-    (*value_.map_)[keey] = (*this)[i + 1];
-  }
-  // erase the last one ("leftover")
-  CZString keyLast(oldSize - 1);
-  auto itLast = value_.map_->find(keyLast);
-  value_.map_->erase(itLast);
+    *removed = std::move(*it);
+  // shift all items after the "removed" left, into its place
+  value_.array_->erase(it);
   return true;
 }
 
@@ -3700,13 +5186,11 @@ Value::Members Value::getMemberNames() const {
       "in Json::Value::getMemberNames(), value must be objectValue");
   if (type() == nullValue)
     return Value::Members();
+  // Members are kept in insertion order, but listed in key order
   Members members;
   members.reserve(value_.map_->size());
-  ObjectValues::const_iterator it = value_.map_->begin();
-  ObjectValues::const_iterator itEnd = value_.map_->end();
-  for (; it != itEnd; ++it) {
-    members.push_back(String((*it).first.data(), (*it).first.length()));
-  }
+  for (auto const* member : sortedMembers(*value_.map_))
+    members.push_back(String(member->first.data(), member->first.length()));
   return members;
 }
 //
@@ -3936,6 +5420,9 @@ String Value::toStyledString() const {
 Value::const_iterator Value::begin() const {
   switch (type()) {
   case arrayValue:
+    if (value_.array_)
+      return const_iterator(value_.array_->data(), value_.array_->data());
+    break;
   case objectValue:
     if (value_.map_)
       return const_iterator(value_.map_->begin());
@@ -3949,6 +5436,10 @@ Value::const_iterator Value::begin() const {
 Value::const_iterator Value::end() const {
   switch (type()) {
   case arrayValue:
+    if (value_.array_)
+      return const_iterator(value_.array_->data() + value_.array_->size(),
+                            value_.array_->data());
+    break;
   case objectValue:
     if (value_.map_)
       return const_iterator(value_.map_->end());
@@ -3962,6 +5453,9 @@ Value::const_iterator Value::end() const {
 Value::iterator Value::begin() {
   switch (type()) {
   case arrayValue:
+    if (value_.array_)
+      return iterator(value_.array_->data(), value_.array_->data());
+    break;
   case objectValue:
     if (value_.map_)
       return iterator(value_.map_->begin());
@@ -3975,6 +5469,10 @@ Value::iterator Value::begin() {
 Value::iterator Value::end() {
   switch (type()) {
   case arrayValue:
+    if (value_.array_)
+      return iterator(value_.array_->data() + value_.array_->size(),
+                      value_.array_->data());
+    break;
   case objectValue:
     if (value_.map_)
       return iterator(value_.map_->end());
@@ -4232,9 +5730,8 @@ using StreamWriterPtr = std::unique_ptr<StreamWriter>;
 typedef std::auto_ptr<StreamWriter> StreamWriterPtr;
 #endif
 
-String valueToString(LargestInt value) {
-  UIntToStringBuffer buffer;
-  char* current = buffer + sizeof(buffer);
+// Like uintToString, but signed. The buffer needs one more char for the sign.
+static void intToString(LargestInt value, char*& current) {
   if (value == Value::minLargestInt) {
     uintToString(LargestUInt(Value::maxLargestInt) + 1, current);
     *--current = '-';
@@ -4244,6 +5741,12 @@ String valueToString(LargestInt value) {
   } else {
     uintToString(LargestUInt(value), current);
   }
+}
+
+String valueToString(LargestInt value) {
+  UIntToStringBuffer buffer;
+  char* current = buffer + sizeof(buffer);
+  intToString(value, current);
   assert(current >= buffer);
   return current;
 }
@@ -4319,16 +5822,52 @@ String valueToString(double value,
 
 String valueToString(bool value) { return value ? "true" : "false"; }
 
-static bool isAnyCharRequiredQuoting(char const* s, size_t n) {
-  assert(s || !n);
-
-  char const* const end = s + n;
-  for (char const* cur = s; cur < end; ++cur) {
-    if (*cur == '\\' || *cur == '\"' || *cur < ' ' ||
-        static_cast<unsigned char>(*cur) < 0x80)
-      return true;
+// Return true if the character has to be escaped. Non-ASCII characters are
+// escaped as \u sequences.
+static bool isEscapedChar(char c) {
+  return c == '\\' || c == '\"' || static_cast<unsigned char>(c) < 0x20 ||
+         static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Return the first character in [s, end) that has to be escaped, or end if
+// there is none. Strings are mostly clean, so look at a vector of characters
+// at a time. Signed, c < 0x20 holds for both control and non-ASCII characters.
+static char const* findEscapedChar(char const* s, char const* end) {
+#if defined(JSONCPP_HAS_AVX2)
+  const __m256i quote32 = _mm256_set1_epi8('"');
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  const __m256i space32 = _mm256_set1_epi8(' ');
+  for (; end - s >= 32; s += 32) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s));
+    __m256i escaped =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, quote32),
+                                        _mm256_cmpeq_epi8(chars, backslash32)),
+                        _mm256_cmpgt_epi8(space32, chars));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(escaped));
+    if (mask)
+      return s + countTrailingZeros(mask);
   }
-  return false;
+#endif
+#if defined(JSONCPP_HAS_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i space = _mm_set1_epi8(' ');
+  for (; end - s >= 16; s += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    __m128i escaped = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                     _mm_cmpeq_epi8(chars, backslash)),
+        _mm_cmplt_epi8(chars, space));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(escaped));
+    if (mask)
+      return s + countTrailingZeros(mask);
+  }
+#endif
+  for (; s != end; ++s) {
+    if (isEscapedChar(*s))
+      return s;
+  }
+  return end;
 }
 
 static unsigned int utf8ToCodepoint(const char*& s, const char* e) {
@@ -4410,21 +5949,22 @@ static String toHex16Bit(unsigned int x) {
   return result;
 }
 
-static String valueToQuotedStringN(const char* value, unsigned length) {
-  if (value == nullptr)
-    return "";
-
-  if (!isAnyCharRequiredQuoting(value, length))
-    return String("\"") + value + "\"";
-  // We have to walk value and escape any special characters.
-  // Appending to String is not efficient, but this should be rare.
+// Append value, quoted and escaped, to result.
+static void appendQuotedString(String& result,
+                               const char* value,
+                               unsigned length) {
+  // Copy runs of characters that need no escaping in bulk, and escape the
+  // special characters between them.
   // (Note: forward slashes are *not* rare, but I am not escaping them.)
-  String::size_type maxsize = length * 2 + 3; // allescaped+quotes+NULL
-  String result;
-  result.reserve(maxsize); // to avoid lots of mallocs
   result += "\"";
   char const* end = value + length;
-  for (const char* c = value; c != end; ++c) {
+  for (const char* c = value;; ++c) {
+    char const* clean = c;
+    c = findEscapedChar(c, end);
+    result.append(clean, c);
+    if (c == end)
+      break;
+
     switch (*c) {
     case '\"':
       result += "\\\"";
@@ -4476,6 +6016,71 @@ static String valueToQuotedStringN(const char* value, unsigned length) {
     }
   }
   result += "\"";
+}
+
+// Append a member name, quoted and escaped, to result
+static void appendQuotedName(String& result, char const* name, char const* end,
+                             bool plain) {
+  if (!plain) {
+    appendQuotedString(result, name, static_cast<unsigned>(end - name));
+    return;
+  }
+  result += '"';
+  result.append(name, end);
+  result += '"';
+}
+
+namespace {
+// An object member, as writers emit it
+struct WrittenMember {
+  char const* name;
+  char const* nameEnd;
+  bool plainName;
+  Value const* value;
+
+  // Names compare as keys do
+  bool operator<(WrittenMember const& other) const {
+    size_t length = static_cast<size_t>(nameEnd - name);
+    size_t otherLength = static_cast<size_t>(other.nameEnd - other.name);
+    int comp = memcmp(name, other.name, std::min(length, otherLength));
+    return comp < 0 || (comp == 0 && length < otherLength);
+  }
+};
+} // namespace
+
+// Call fn(member, isLast) on each member of an object, in key order (as listed
+// by getMemberNames()), although objects keep them in insertion order. Most
+// objects are small records, which are sorted on the stack
+template <typename Fn>
+static void forEachMemberInKeyOrder(Value const& value, Fn fn) {
+  WrittenMember small[16];
+  std::vector<WrittenMember> large;
+  WrittenMember* members = small;
+  if (value.size() > sizeof(small) / sizeof(small[0])) {
+    large.resize(value.size());
+    members = large.data();
+  }
+
+  size_t size = 0;
+  for (auto it = value.begin(), end = value.end(); it != end; ++it) {
+    WrittenMember& member = members[size++];
+    member.name = it.memberName(&member.nameEnd);
+    member.plainName = it.isPlainInternedName();
+    member.value = &*it;
+  }
+  if (!std::is_sorted(members, members + size))
+    std::sort(members, members + size);
+  for (size_t i = 0; i < size; ++i)
+    fn(members[i], i + 1 == size);
+}
+
+static String valueToQuotedStringN(const char* value, unsigned length) {
+  if (value == nullptr)
+    return "";
+
+  String result;
+  result.reserve(length + 2); // quotes
+  appendQuotedString(result, value, length);
   return result;
 }
 
@@ -5108,28 +6713,26 @@ void BuiltStyledStreamWriter::writeValue(Value const& value) {
     writeArrayValue(value);
     break;
   case objectValue: {
-    Value::Members members(value.getMemberNames());
-    if (members.empty())
+    if (value.empty())
       pushValue("{}");
     else {
       writeWithIndent("{");
       indent();
-      auto it = members.begin();
-      for (;;) {
-        String const& name = *it;
-        Value const& childValue = value[name];
+      // Members are visited in place, rather than looked up by name
+      String name;
+      forEachMemberInKeyOrder(value, [&](WrittenMember const& member,
+                                         bool isLast) {
+        Value const& childValue = *member.value;
         writeCommentBeforeValue(childValue);
-        writeWithIndent(valueToQuotedStringN(
-            name.data(), static_cast<unsigned>(name.length())));
+        name.clear();
+        appendQuotedName(name, member.name, member.nameEnd, member.plainName);
+        writeWithIndent(name);
         *sout_ << colonSymbol_;
         writeValue(childValue);
-        if (++it == members.end()) {
-          writeCommentAfterValueOnSameLine(childValue);
-          break;
-        }
-        *sout_ << ",";
+        if (!isLast)
+          *sout_ << ",";
         writeCommentAfterValueOnSameLine(childValue);
-      }
+      });
       unindent();
       writeWithIndent("}");
     }
@@ -5393,6 +6996,95 @@ OStream& operator<<(OStream& sout, Value const& root) {
   return sout;
 }
 
+////////////////////////////////
+// CompactWriter
+
+CompactWriter::Sink::~Sink() = default;
+
+CompactWriter::CompactWriter(Sink& sink, size_t bufferSize)
+    : sink_(sink), bufferSize_(bufferSize) {
+  // Leave room for the value that takes the buffer past bufferSize
+  buffer_.reserve(bufferSize + bufferSize / 4);
+}
+
+CompactWriter::~CompactWriter() { flush(); }
+
+void CompactWriter::write(Value const& root) {
+  writeValue(root);
+  buffer_ += '\n';
+  if (buffer_.size() >= bufferSize_)
+    flush();
+}
+
+void CompactWriter::flush() {
+  if (buffer_.empty())
+    return;
+  sink_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void CompactWriter::writeValue(Value const& value) {
+  switch (value.type()) {
+  case nullValue:
+    buffer_ += "null";
+    break;
+  case intValue:
+  case uintValue: {
+    UIntToStringBuffer digits;
+    char* const end = digits + sizeof(digits) - 1; // Excluding the nul
+    char* current = end + 1;
+    if (value.type() == intValue)
+      intToString(value.asLargestInt(), current);
+    else
+      uintToString(value.asLargestUInt(), current);
+    buffer_.append(current, end);
+    break;
+  }
+  case realValue:
+    buffer_ += valueToString(value.asDouble());
+    break;
+  case stringValue: {
+    char const* str;
+    char const* end;
+    if (value.getString(&str, &end))
+      appendQuotedString(buffer_, str, static_cast<unsigned>(end - str));
+    break;
+  }
+  case booleanValue:
+    buffer_ += value.asBool() ? "true" : "false";
+    break;
+  case arrayValue: {
+    buffer_ += '[';
+    bool first = true;
+    for (auto const& element : value) {
+      if (!first)
+        buffer_ += ',';
+      first = false;
+      writeValue(element);
+      if (buffer_.size() >= bufferSize_)
+        flush();
+    }
+    buffer_ += ']';
+    break;
+  }
+  case objectValue: {
+    buffer_ += '{';
+    forEachMemberInKeyOrder(value, [&](WrittenMember const& member,
+                                       bool isLast) {
+      appendQuotedName(buffer_, member.name, member.nameEnd, member.plainName);
+      buffer_ += ':';
+      writeValue(*member.value);
+      if (!isLast)
+        buffer_ += ',';
+      if (buffer_.size() >= bufferSize_)
+        flush();
+    });
+    buffer_ += '}';
+    break;
+  }
+  }
+}
+
 } // namespace Json
 
 // //////////////////////////////////////////////////////////////////////
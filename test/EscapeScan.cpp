@@ -0,0 +1,28 @@
+//===-- EscapeScan.cpp - One variant of the jsoncpp escape scan -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// The vendored jsoncpp, compiled into its own namespace (`Json<VARIANT>`), so
+/// that copies compiled for different instruction sets (see CMakeLists.txt)
+/// can be linked into one test and their outputs compared.
+///
+//===----------------------------------------------------------------------===//
+
+#define ESCAPE_SCAN_CAT_(A, B) A##B
+#define ESCAPE_SCAN_CAT(A, B) ESCAPE_SCAN_CAT_(A, B)
+#define Json ESCAPE_SCAN_CAT(Json, ESCAPE_SCAN_VARIANT)
+
+#include "jsoncpp.cpp"
+
+namespace escapetest {
+std::string ESCAPE_SCAN_CAT(quote, ESCAPE_SCAN_VARIANT)(const char *Data,
+                                                        size_t Length) {
+  return Json::valueToQuotedStringN(Data, static_cast<unsigned>(Length));
+}
+} // namespace escapetest
@@ -0,0 +1,138 @@
+//===-- EscapeTest.cpp - Test the SIMD jsoncpp escape scan ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Checks that the jsoncpp writer quotes strings identically whether the
+/// characters to escape are found with SIMD (SSE2 or AVX2, depending on
+/// ESCAPE_TEST_VARIANT) or one character at a time. Strings are generated
+/// around the vector widths: a single character to escape (of every class) at
+/// every position, at several alignments, plus random strings.
+///
+/// Exits with 77 (skipped) if the CPU does not support the variant.
+///
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define ESCAPE_TEST_CAT_(A, B) A##B
+#define ESCAPE_TEST_CAT(A, B) ESCAPE_TEST_CAT_(A, B)
+#define ESCAPE_TEST_STR_(A) #A
+#define ESCAPE_TEST_STR(A) ESCAPE_TEST_STR_(A)
+
+namespace escapetest {
+std::string quoteScalar(const char *Data, size_t Length);
+std::string ESCAPE_TEST_CAT(quote, ESCAPE_TEST_VARIANT)(const char *Data,
+                                                        size_t Length);
+} // namespace escapetest
+
+using namespace escapetest;
+
+namespace {
+
+// Characters that must be escaped (every class: quotes, backslashes, control
+// characters and non-ASCII bytes), and clean characters next to them
+std::string escapedChars() {
+  std::string Chars = "\"\\";
+  for (int C = 0; C < 0x20; ++C) {
+    Chars += static_cast<char>(C);
+  }
+  for (int C : {0x80, 0xa9, 0xbf, 0xc3, 0xe2, 0xf0, 0xff}) {
+    Chars += static_cast<char>(C);
+  }
+  return Chars;
+}
+
+const char CleanChars[] = " !#[]~\x7f";
+
+unsigned NumFailures = 0;
+
+void check(const char *Data, size_t Length) {
+  const auto Expected = quoteScalar(Data, Length);
+  const auto Actual = ESCAPE_TEST_CAT(quote, ESCAPE_TEST_VARIANT)(Data, Length);
+  if (Expected == Actual || ++NumFailures > 10) {
+    return;
+  }
+
+  std::printf("mismatch quoting (length %zu):", Length);
+  for (size_t I = 0; I < Length; ++I) {
+    std::printf(" %02x", static_cast<unsigned char>(Data[I]));
+  }
+  std::printf("\n  scalar: %s\n  " ESCAPE_TEST_STR(ESCAPE_TEST_VARIANT) ": %s\n",
+              Expected.c_str(), Actual.c_str());
+}
+
+} // anonymous namespace
+
+int main() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  if (!__builtin_cpu_supports(ESCAPE_TEST_CPU_FEATURE)) {
+    std::printf("CPU does not support %s, skipping\n", ESCAPE_TEST_CPU_FEATURE);
+    return 77;
+  }
+#endif
+
+  // Strings are copied to the buffer at an offset, to vary their alignment
+  std::vector<char> Buffer(512);
+  auto place = [&](const std::string &Str, size_t Offset) {
+    std::memcpy(Buffer.data() + Offset, Str.data(), Str.size());
+    return Buffer.data() + Offset;
+  };
+
+  // One character at each position around the 16- and 32-byte boundaries,
+  // alone or followed by another one at the end
+  const auto Escaped = escapedChars();
+  for (size_t Length = 0; Length <= 100; ++Length) {
+    const std::string Clean(Length, 'a');
+    for (size_t Offset : {0, 1, 15, 31}) {
+      check(place(Clean, Offset), Length);
+    }
+
+    for (size_t Pos = 0; Pos < Length; ++Pos) {
+      for (char C : Escaped) {
+        auto Str = Clean;
+        Str[Pos] = C;
+        for (size_t Offset : {0, 1, 15, 31}) {
+          check(place(Str, Offset), Length);
+        }
+        Str.back() = '"';
+        check(place(Str, 0), Length);
+      }
+
+      for (const char *C = CleanChars; *C; ++C) {
+        auto Str = Clean;
+        Str[Pos] = *C;
+        check(place(Str, 0), Length);
+      }
+    }
+  }
+
+  // Random strings, mostly printable ASCII
+  std::mt19937 Rand(42);
+  std::uniform_int_distribution<size_t> RandLength(0, 300);
+  std::uniform_int_distribution<int> RandPercent(0, 99), RandPrintable(0x20, 0x7e),
+      RandByte(0, 0xff);
+  for (unsigned I = 0; I < 20000; ++I) {
+    std::string Str(RandLength(Rand), ' ');
+    for (auto &C : Str) {
+      C = static_cast<char>(RandPercent(Rand) < 90 ? RandPrintable(Rand)
+                                                   : RandByte(Rand));
+    }
+    check(place(Str, I % 32), Str.size());
+  }
+
+  if (NumFailures) {
+    std::printf("%u mismatches\n", NumFailures);
+    return 1;
+  }
+  return 0;
+}
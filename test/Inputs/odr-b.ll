@@ -0,0 +1,19 @@
+; See odr-a.ll
+
+define linkonce_odr i32 @inline_max(i32 %x, i32 %y) {
+entry:
+  %cmp = icmp sgt i32 %x, %y
+  br i1 %cmp, label %then, label %else
+
+then:
+  ret i32 %x
+
+else:
+  ret i32 %y
+}
+
+define i32 @b(i32 %x) {
+entry:
+  %r = call i32 @inline_max(i32 %x, i32 0)
+  ret i32 %r
+}
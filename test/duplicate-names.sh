@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Inputs that share a file name (same-named archive members, or files in
+# different directories) must not overwrite each other's output: the outputs of
+# later inputs are numbered instead.
+#
+# Usage: duplicate-names.sh <cfg-extract> <llvm-as> <llvm-ar> <inputs directory>
+
+set -eu
+
+CFG_EXTRACT=$1
+LLVM_AS=$2
+LLVM_AR=$3
+INPUTS=$4
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# Two modules named foo.bc, in different directories and in one archive (with
+# `q`, as `r` would replace the first member)
+mkdir "$OUT/a" "$OUT/b" "$OUT/cfg"
+"$LLVM_AS" "$INPUTS/odr-a.ll" -o "$OUT/a/foo.bc"
+"$LLVM_AS" "$INPUTS/odr-b.ll" -o "$OUT/b/foo.bc"
+"$LLVM_AR" qc "$OUT/lib.a" "$OUT/a/foo.bc"
+"$LLVM_AR" q "$OUT/lib.a" "$OUT/b/foo.bc"
+
+"$CFG_EXTRACT" -j=4 -cfg-outdir="$OUT/cfg" "$OUT/lib.a" "$OUT/a/foo.bc" \
+  "$OUT/b/foo.bc" 2>/dev/null
+
+# Whether an output has the function defined by only one of the modules
+has_function() {
+  grep -Eq "\"name\" *: *\"$2\"" "$OUT/cfg/cfg.$1.json"
+}
+
+for NAME in 'lib.a(foo.bc)' foo.bc; do
+  if ! has_function "$NAME" a || ! has_function "$NAME.2" b; then
+    echo "FAIL: cfg.$NAME.json should be odr-a.ll's output, and" \
+      "cfg.$NAME.2.json odr-b.ll's"
+    exit 1
+  fi
+done
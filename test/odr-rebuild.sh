@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# With -cfg-dedup-odr, a module that is rebuilt must emit the ODR functions it
+# claimed in the previous build again (rather than a reference to its own,
+# overwritten, output), while other modules still only reference them.
+#
+# Usage: odr-rebuild.sh <cfg-extract> <inputs directory>
+
+set -eu
+
+CFG_EXTRACT=$1
+INPUTS=$2
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+extract() {
+  "$CFG_EXTRACT" -cfg-dedup-odr -cfg-outdir="$OUT" "$INPUTS/$1" 2>/dev/null
+}
+
+# Whether a module's output references the ODR function, rather than emitting it
+has_ref() {
+  grep -q '"odr_ref"' "$OUT/cfg.$1.json"
+}
+
+extract odr-a.ll
+extract odr-b.ll
+if has_ref odr-a.ll || ! has_ref odr-b.ll; then
+  echo "FAIL: odr-a.ll should emit inline_max, and odr-b.ll reference it"
+  exit 1
+fi
+
+# Rebuild both modules
+extract odr-a.ll
+extract odr-b.ll
+if has_ref odr-a.ll; then
+  echo "FAIL: rebuilt odr-a.ll only references its own claim on inline_max"
+  exit 1
+fi
+if ! has_ref odr-b.ll; then
+  echo "FAIL: rebuilt odr-b.ll emits inline_max, claimed by odr-a.ll"
+  exit 1
+fi